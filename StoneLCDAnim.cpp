@@ -0,0 +1,163 @@
+// ************************************************
+// StoneLCDAnim.cpp                              **
+// ***************************************************************************
+/* Implementation of StoneLCDAnim; keyframe animations of Stone HMI Display
+ * variables (icons, progress bars...) stepped from millis() on a fixed
+ * tick, with every change of a tick sent in one batch. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDAnim.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                          S t o n e L C D A n i m                       ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDAnim::StoneLCDAnim(StoneLCD *display) {
+  this->lcd = display;
+  this->tickMs = STONE_ANIM_DEFAULT_TICK;
+  this->lastTickAt = 0;
+  this->stopAll();
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+// Track to use for an animation of address: the one already animating it,
+// or a free one. -1 if there's none.
+int8_t StoneLCDAnim::freeTrack(uint16_t address) {
+  int8_t i, found = -1;
+
+  for (i = 0; i < STONE_ANIM_MAX_TRACKS; i++) {
+    if (!this->tracks[i].playing) {
+      if (found < 0) found = i;
+    } else if (address != STONE_ANIM_NO_ADDRESS && this->tracks[i].address == address) {
+      return i;
+    }
+  }
+  return found;
+}
+
+uint16_t StoneLCDAnim::valueAt(StoneLCDAnimTrack *t, unsigned long elapsed) {
+  const StoneLCDKeyframe *a, *b;
+  uint16_t total = t->frames[t->count - 1].atMs;
+  uint8_t i;
+
+  if ((t->flags & STONE_ANIM_LOOP) && total > 0) elapsed %= total;
+  if (elapsed >= total) return t->frames[t->count - 1].value;
+
+  for (i = 0; i + 1 < t->count && t->frames[i + 1].atMs <= elapsed; i++);
+  a = &t->frames[i];
+  if (!(t->flags & STONE_ANIM_LINEAR) || i + 1 >= t->count || elapsed < a->atMs) return a->value;
+  b = &t->frames[i + 1];
+  return a->value + (int32_t)((int32_t)b->value - a->value) * (int32_t)(elapsed - a->atMs) / (b->atMs - a->atMs);
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+void StoneLCDAnim::setTickMs(uint16_t ms) {
+  this->tickMs = ms;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// Animates a variable through count keyframes (which must stay valid while
+// it plays). Any animation of the same address is replaced. The handler,
+// if any, is called with each new value. Looping animations start over at
+// the time of their last keyframe, so with STONE_ANIM_STEP that keyframe
+// only marks the end of the loop. Returns the track, or -1 if none is free.
+int8_t StoneLCDAnim::play(uint16_t address, const StoneLCDKeyframe *frames, uint8_t count, uint8_t flags, StoneLCDAnimHandler handler) {
+  StoneLCDAnimTrack *t;
+  int8_t track;
+
+  if (frames == NULL || count == 0) return -1;
+  track = this->freeTrack(address);
+  if (track < 0) return -1;
+
+  t = &this->tracks[track];
+  t->playing = true;
+  t->address = address;
+  t->flags = flags;
+  t->count = count;
+  t->frames = frames;
+  t->startedAt = millis();
+  t->sent = false;
+  t->handler = handler;
+  return track;
+}
+
+// Goes from one value to another in ms (e.g. a progress bar)
+int8_t StoneLCDAnim::tween(uint16_t address, uint16_t from, uint16_t to, uint16_t ms, StoneLCDAnimHandler handler) {
+  StoneLCDAnimTrack *t;
+  int8_t track = this->freeTrack(address);
+
+  if (track < 0) return -1;
+  t = &this->tracks[track];
+  t->tween[0].atMs = 0;
+  t->tween[0].value = from;
+  t->tween[1].atMs = ms;
+  t->tween[1].value = to;
+  return this->play(address, t->tween, 2, STONE_ANIM_LINEAR, handler);
+}
+
+// The variable keeps the last value sent
+void StoneLCDAnim::stop(int8_t track) {
+  if (track >= 0 && track < STONE_ANIM_MAX_TRACKS) this->tracks[track].playing = false;
+}
+
+void StoneLCDAnim::stopAll() {
+  uint8_t i;
+  for (i = 0; i < STONE_ANIM_MAX_TRACKS; i++) this->tracks[i].playing = false;
+}
+
+boolean StoneLCDAnim::isPlaying(int8_t track) {
+  if (track < 0 || track >= STONE_ANIM_MAX_TRACKS) return false;
+  return this->tracks[track].playing;
+}
+
+// Call this often (e.g. from loop()). Once per tick it works out the value
+// of every track, and sends the ones that changed in a single batch (unless
+// a batch was already open, which they join). It never waits. Returns true
+// when something changed.
+boolean StoneLCDAnim::update() {
+  StoneLCDAnimTrack *t;
+  unsigned long now = millis(), elapsed;
+  uint16_t value;
+  uint8_t i;
+  boolean ownBatch, changed = false;
+
+  if (now - this->lastTickAt < this->tickMs) return false;
+  // Stay on the tick grid, but don't try to catch up on missed ticks
+  this->lastTickAt += this->tickMs;
+  if (now - this->lastTickAt >= this->tickMs) this->lastTickAt = now;
+
+  ownBatch = !this->lcd->isBatching();
+  if (ownBatch) this->lcd->beginBatch();
+
+  for (i = 0; i < STONE_ANIM_MAX_TRACKS; i++) {
+    t = &this->tracks[i];
+    if (!t->playing) continue;
+    elapsed = now - t->startedAt;
+    value = this->valueAt(t, elapsed);
+    if (!(t->flags & STONE_ANIM_LOOP) && elapsed >= t->frames[t->count - 1].atMs) t->playing = false;
+    if (t->sent && value == t->lastValue) continue;
+
+    t->lastValue = value;
+    t->sent = true;
+    changed = true;
+    if (t->address != STONE_ANIM_NO_ADDRESS) this->lcd->writeVariableWord(t->address, value);
+    if (t->handler != NULL) t->handler(i, value);
+  }
+
+  if (ownBatch) this->lcd->flushBatch();
+  return changed;
+}
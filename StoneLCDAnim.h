@@ -0,0 +1,92 @@
+// ************************************************
+// StoneLCDAnim.h                                **
+// ***************************************************************************
+/* Header for StoneLCDAnim; keyframe animations of Stone HMI Display
+ * variables (icons, progress bars...) stepped from millis() on a fixed
+ * tick, with every change of a tick sent in one batch. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_ANIM_H__
+#define _STONE_LCD_ANIM_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Animations a StoneLCDAnim object can play at the same time
+#ifndef STONE_ANIM_MAX_TRACKS
+#define STONE_ANIM_MAX_TRACKS           4
+#endif
+
+#define STONE_ANIM_DEFAULT_TICK         20      // ms (50 fps)
+
+// Tracks with this address aren't written to the display; only their
+// handler is called (e.g. to drive something on the Arduino side).
+#define STONE_ANIM_NO_ADDRESS           0xFFFF
+
+// --- Flags ---------------------------------------------------
+#define STONE_ANIM_STEP                 0x00  // Holds each value until the next keyframe (icons)
+#define STONE_ANIM_LINEAR               0x01  // Goes gradually from a value to the next (bars)
+#define STONE_ANIM_LOOP                 0x02  // Starts over after the last keyframe
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+typedef struct {
+  uint16_t atMs;           // Since the start of the animation; must grow from one keyframe to the next
+  uint16_t value;
+} StoneLCDKeyframe;
+
+typedef void (*StoneLCDAnimHandler)(int8_t track, uint16_t value);
+
+typedef struct {
+  boolean  playing;
+  uint16_t address;
+  uint8_t  flags;
+  uint8_t  count;
+  const StoneLCDKeyframe *frames;
+  StoneLCDKeyframe tween[2];       // Keyframes of tween()
+  unsigned long startedAt;
+  boolean  sent;                   // lastValue has been output
+  uint16_t lastValue;
+  StoneLCDAnimHandler handler;
+} StoneLCDAnimTrack;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                          S t o n e L C D A n i m                       ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDAnim {
+private:
+  StoneLCD *lcd;
+  uint16_t tickMs;
+  unsigned long lastTickAt;
+  StoneLCDAnimTrack tracks[STONE_ANIM_MAX_TRACKS];
+
+  int8_t   freeTrack(uint16_t address);
+  uint16_t valueAt(StoneLCDAnimTrack *t, unsigned long elapsed);
+
+public:
+  StoneLCDAnim(StoneLCD *display);
+
+  void    setTickMs(uint16_t ms);
+
+  int8_t  play(uint16_t address, const StoneLCDKeyframe *frames, uint8_t count, uint8_t flags = STONE_ANIM_STEP, StoneLCDAnimHandler handler = NULL);
+  int8_t  tween(uint16_t address, uint16_t from, uint16_t to, uint16_t ms, StoneLCDAnimHandler handler = NULL);
+  void    stop(int8_t track);
+  void    stopAll();
+  boolean isPlaying(int8_t track);
+
+  boolean update();
+};
+#endif
@@ -0,0 +1,148 @@
+// ************************************************
+// StoneLCDClock.cpp                             **
+// ***************************************************************************
+/* Implementation of StoneLCDClock; local clock that follows the RTC of a
+ * Stone HMI Display from millis(), reading it only now and then. Part of
+ * StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDClock.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            M A C R O S                                 ##
+ *##                                                                        ##
+ *############################################################################*/
+#define tryOrReturnFalse(f)         if(!(f)) return false
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D C l o c k                      ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDClock::StoneLCDClock(StoneLCD *display) {
+  this->lcd = display;
+  this->synced = false;
+  this->syncedEpoch = 0;
+  this->syncedAt = 0;
+  this->resyncMs = STONE_CLOCK_DEFAULT_RESYNC;
+  this->currentResyncMs = STONE_CLOCK_DEFAULT_RESYNC;
+  this->maxDrift = STONE_CLOCK_DEFAULT_MAX_DRIFT;
+  this->lastDrift = 0;
+  this->readHandle = -1;
+  this->requestedAt = 0;
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+// Takes a reading of the RTC (done at millis() = at). If the local clock
+// had drifted more than allowed, the next reading comes sooner; otherwise
+// the interval goes back to the configured one.
+void StoneLCDClock::applySync(uint32_t rtc, unsigned long at) {
+  if (this->synced) {
+    this->lastDrift = (long)(rtc - (this->syncedEpoch + (at - this->syncedAt) / 1000));
+    if (this->lastDrift > this->maxDrift || this->lastDrift < -(long)this->maxDrift) {
+      this->currentResyncMs >>= 1;
+      if (this->currentResyncMs < STONE_CLOCK_MIN_RESYNC) this->currentResyncMs = STONE_CLOCK_MIN_RESYNC;
+    } else {
+      this->currentResyncMs = this->resyncMs;
+    }
+  }
+  this->syncedEpoch = rtc;
+  this->syncedAt = at;
+  this->synced = true;
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+void StoneLCDClock::setResyncIntervalMs(uint32_t ms) {
+  this->resyncMs = ms;
+  this->currentResyncMs = ms;
+}
+
+// Seconds the local clock can be off at a resync before resyncs are made
+// more often. The RTC only reports whole seconds, so this should be at
+// least 1.
+void StoneLCDClock::setMaxDrift(uint8_t seconds) {
+  this->maxDrift = seconds;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+boolean StoneLCDClock::isSynced() {
+  return this->synced;
+}
+
+// Seconds the RTC was ahead of the local clock at the last resync
+long StoneLCDClock::getDrift() {
+  return this->lastDrift;
+}
+
+// Unix time, extrapolated from the last RTC reading. 0 until the first one.
+uint32_t StoneLCDClock::now() {
+  if (!this->synced) return 0;
+  return this->syncedEpoch + (millis() - this->syncedAt) / 1000;
+}
+
+boolean StoneLCDClock::getDateTime(StoneLCDDateTime *dst) {
+  if (dst == NULL || !this->synced) return false;
+  dst->setFromEpoch(this->now());
+  return true;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// Reads the RTC right away, waiting for the reply
+boolean StoneLCDClock::sync() {
+  StoneLCDDateTime rtc;
+  unsigned long at = millis();
+
+  tryOrReturnFalse (this->lcd->getRTC(&rtc));
+  this->applySync(rtc.getEpoch(), at);
+  return true;
+}
+
+// Sets the RTC, and the local clock with it
+boolean StoneLCDClock::set(StoneLCDDateTime *src) {
+  if (src == NULL) return false;
+  tryOrReturnFalse (this->lcd->setRTC(src));
+  this->synced = false;
+  this->applySync(src->getEpoch(), millis());
+  return true;
+}
+
+// Call this often (e.g. from loop()). When a resync is due it requests the
+// RTC without waiting, and takes the reply on a later call. Returns true
+// when the clock was resynced.
+boolean StoneLCDClock::update() {
+  uint8_t status;
+  StoneLCDDateTime rtc;
+
+  if (this->readHandle >= 0) {
+    status = this->lcd->getReadStatus(this->readHandle);
+    if (status == STONE_READ_PENDING) return false;
+    this->readHandle = -1;
+    if (status != STONE_READ_DONE) return false;
+    rtc.setFromBCDBuffer(this->rtcBuffer);
+    this->applySync(rtc.getEpoch(), this->requestedAt);
+    return true;
+  }
+
+  if (this->synced && millis() - this->syncedAt < this->currentResyncMs) return false;
+  // After a failed read, wait a bit before the next one
+  if (this->requestedAt != 0 && millis() - this->requestedAt < STONE_CLOCK_RETRY_MS) return false;
+  this->requestedAt = millis();
+  this->readHandle = this->lcd->requestRegisterRead(STONE_REG_RTC_NOW, this->rtcBuffer, STONE_DATETIME_BDC_BUFFER_SIZE);
+  return false;
+}
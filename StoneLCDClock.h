@@ -0,0 +1,63 @@
+// ************************************************
+// StoneLCDClock.h                               **
+// ***************************************************************************
+/* Header for StoneLCDClock; local clock that follows the RTC of a Stone HMI
+ * Display from millis(), reading it only now and then. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_CLOCK_H__
+#define _STONE_LCD_CLOCK_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+#define STONE_CLOCK_DEFAULT_RESYNC      3600000UL // ms between RTC reads
+#define STONE_CLOCK_MIN_RESYNC          60000UL   // ... never shorter than this
+#define STONE_CLOCK_DEFAULT_MAX_DRIFT   2         // s
+#define STONE_CLOCK_RETRY_MS            1000      // ms between failed RTC reads
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D C l o c k                      ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDClock {
+private:
+  StoneLCD *lcd;
+  boolean  synced;
+  uint32_t syncedEpoch;            // RTC time at the last sync
+  unsigned long syncedAt;          // millis() then
+  uint32_t resyncMs;               // Configured interval
+  uint32_t currentResyncMs;        // Interval in use, shorter while drifting
+  uint8_t  maxDrift;
+  long     lastDrift;
+  int8_t   readHandle;
+  unsigned long requestedAt;
+  uint8_t  rtcBuffer[STONE_DATETIME_BDC_BUFFER_SIZE];
+
+  void     applySync(uint32_t rtc, unsigned long at);
+
+public:
+  StoneLCDClock(StoneLCD *display);
+
+  void     setResyncIntervalMs(uint32_t ms);
+  void     setMaxDrift(uint8_t seconds);
+
+  boolean  isSynced();
+  long     getDrift();
+  uint32_t now();
+  boolean  getDateTime(StoneLCDDateTime *dst);
+
+  boolean  sync();
+  boolean  set(StoneLCDDateTime *src);
+  boolean  update();
+};
+#endif
@@ -0,0 +1,308 @@
+// ************************************************
+// StoneLCDDatabase.cpp                          **
+// ***************************************************************************
+/* Implementation of StoneLCDDatabase; non-blocking bulk transfers between the
+ * host and the flash database (DBL) of Stone HMI Displays. Part of
+ * StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDDatabase.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            M A C R O S                                 ##
+ *##                                                                        ##
+ *############################################################################*/
+#define tryOrReturnFalse(f)         if(!(f)) return false
+
+/*############################################################################
+ *##                                                                        ##
+ *##                      S t o n e L C D D a t a b a s e                   ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+// windowVPAddr is the first of 2 * STONE_DBL_WINDOW_WORDS variables used to
+// stage the data. They must not be used for anything else.
+StoneLCDDatabase::StoneLCDDatabase(StoneLCD *display, uint16_t windowVPAddr) {
+  this->lcd = display;
+  this->vpBase = windowVPAddr;
+  this->pollIntervalMs = STONE_DBL_DEFAULT_POLL_INTERVAL;
+  this->status = STONE_DBL_IDLE;
+  this->pollHandle = -1;
+  this->uploadHandle = -1;
+  this->chunksDone = 0;
+  this->totalWords = 0;
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+boolean StoneLCDDatabase::begin(uint8_t opMode, uint32_t address, uint32_t words) {
+  if (this->status == STONE_DBL_BUSY || words == 0) return false;
+  this->mode = opMode;
+  this->flashAddr = address;
+  this->totalWords = words;
+  this->chunkCount = (words + STONE_DBL_WINDOW_WORDS - 1) / STONE_DBL_WINDOW_WORDS;
+  this->nextTransfer = 0;
+  this->nextOp = 0;
+  this->chunksDone = 0;
+  this->windows[0].state = STONE_DBL_WINDOW_FREE;
+  this->windows[1].state = STONE_DBL_WINDOW_FREE;
+  this->busyWindow = -1;
+  this->failures = 0;
+  this->status = STONE_DBL_BUSY;
+  return true;
+}
+
+uint16_t StoneLCDDatabase::chunkWords(uint32_t chunk) {
+  uint32_t left = this->totalWords - chunk * STONE_DBL_WINDOW_WORDS;
+  return left > STONE_DBL_WINDOW_WORDS ? STONE_DBL_WINDOW_WORDS : left;
+}
+
+// Even chunks use the first window, odd chunks the second one
+uint16_t StoneLCDDatabase::windowVP(uint32_t chunk) {
+  return this->vpBase + (chunk & 1) * STONE_DBL_WINDOW_WORDS;
+}
+
+// Checks whether the running operation is over. The display clears
+// STONE_REG_EN_DBL_OP when it's done, so that register is read (without
+// waiting for the reply) every poll interval.
+boolean StoneLCDDatabase::checkOperation() {
+  uint8_t readStatus;
+  StoneLCDDBLWindow *w;
+
+  if (this->busyWindow < 0) return true;
+  if (this->pollHandle >= 0) {
+    readStatus = this->lcd->getReadStatus(this->pollHandle);
+    if (readStatus == STONE_READ_PENDING) return true;
+    this->pollHandle = -1;
+    // A lost reply isn't fatal; the register is simply checked again
+    if (readStatus != STONE_READ_DONE) return ++this->failures < STONE_DBL_MAX_FAILURES;
+    this->failures = 0;
+    if (this->opFlag != STONE_DBL_OP_START) {
+      w = &this->windows[this->busyWindow];
+      if (this->mode == STONE_DBL_MODE_WRITE) {
+        w->state = STONE_DBL_WINDOW_FREE;
+        this->chunksDone++;
+      } else {
+        w->state = STONE_DBL_WINDOW_LOADED;
+      }
+      this->busyWindow = -1;
+      return true;
+    }
+  }
+  if (millis() - this->lastPollAt < this->pollIntervalMs) return true;
+  this->lastPollAt = millis();
+  // If no read slot is free, it's tried again on the next call
+  this->pollHandle = this->lcd->requestRegisterRead(STONE_REG_EN_DBL_OP, &this->opFlag, 1);
+  return true;
+}
+
+// Starts the database operation of the next chunk, once its window is ready
+// and the display isn't running another one. The whole setup (0x56 - 0x5F)
+// goes in a single register frame.
+boolean StoneLCDDatabase::startOperation() {
+  uint8_t regs[10];
+  uint32_t address;
+  uint16_t vp, words;
+  StoneLCDDBLWindow *w;
+
+  if (this->busyWindow >= 0 || this->nextOp >= this->chunkCount) return true;
+  w = &this->windows[this->nextOp & 1];
+  if (this->mode == STONE_DBL_MODE_WRITE) {
+    if (w->state != STONE_DBL_WINDOW_STAGED || w->chunk != this->nextOp) return true;
+  } else if (w->state != STONE_DBL_WINDOW_FREE) {
+    return true;
+  }
+
+  address = this->flashAddr + this->nextOp * STONE_DBL_WINDOW_WORDS;
+  vp = this->windowVP(this->nextOp);
+  words = this->chunkWords(this->nextOp);
+  regs[0] = STONE_DBL_OP_START;
+  regs[1] = this->mode;
+  regs[2] = (uint8_t)(address >> 24);
+  regs[3] = (uint8_t)(address >> 16);
+  regs[4] = (uint8_t)(address >> 8);
+  regs[5] = (uint8_t)(address & 0xff);
+  regs[6] = (uint8_t)(vp >> 8);
+  regs[7] = (uint8_t)(vp & 0xff);
+  regs[8] = (uint8_t)(words >> 8);
+  regs[9] = (uint8_t)(words & 0xff);
+  tryOrReturnFalse (this->lcd->writeRegister(STONE_REG_EN_DBL_OP, regs, sizeof(regs)));
+
+  w->state = STONE_DBL_WINDOW_BUSY;
+  w->chunk = this->nextOp;
+  this->busyWindow = this->nextOp & 1;
+  this->nextOp++;
+  this->lastPollAt = millis();
+  return true;
+}
+
+// Write: sends the next chunk to its window while the display may still be
+// storing the previous one from the other window.
+boolean StoneLCDDatabase::stageChunk() {
+  uint16_t words, *data;
+  uint32_t offset;
+  StoneLCDDBLWindow *w;
+
+  if (this->nextTransfer >= this->chunkCount) return true;
+  w = &this->windows[this->nextTransfer & 1];
+  if (w->state != STONE_DBL_WINDOW_FREE) return true;
+
+  words = this->chunkWords(this->nextTransfer);
+  offset = this->nextTransfer * STONE_DBL_WINDOW_WORDS;
+  if (this->buffer != NULL) {
+    data = &this->buffer[offset];
+  } else {
+    tryOrReturnFalse (this->source(offset, this->staging, words));
+    data = this->staging;
+  }
+  tryOrReturnFalse (this->lcd->writeVariable(this->windowVP(this->nextTransfer), data, words));
+  w->state = STONE_DBL_WINDOW_STAGED;
+  w->chunk = this->nextTransfer;
+  this->nextTransfer++;
+  return true;
+}
+
+// Read: reads the window of the next chunk once it's loaded, a reply frame at
+// a time, while the display may already be loading the following chunk into
+// the other window.
+boolean StoneLCDDatabase::uploadChunk() {
+  uint8_t readStatus;
+  uint16_t words, *dest;
+  uint32_t offset;
+  StoneLCDDBLWindow *w;
+
+  if (this->nextTransfer >= this->chunkCount) return true;
+  w = &this->windows[this->nextTransfer & 1];
+  if (w->state == STONE_DBL_WINDOW_LOADED) {
+    w->state = STONE_DBL_WINDOW_UPLOADING;
+    this->uploadPos = 0;
+  }
+  if (w->state != STONE_DBL_WINDOW_UPLOADING) return true;
+
+  words = this->chunkWords(this->nextTransfer);
+  offset = this->nextTransfer * STONE_DBL_WINDOW_WORDS;
+  dest = (this->buffer != NULL) ? &this->buffer[offset] : this->staging;
+  if (this->uploadHandle >= 0) {
+    readStatus = this->lcd->getReadStatus(this->uploadHandle);
+    if (readStatus == STONE_READ_PENDING) return true;
+    this->uploadHandle = -1;
+    if (readStatus == STONE_READ_DONE) {
+      this->uploadPos += this->uploadPiece;
+      this->failures = 0;
+    } else if (++this->failures >= STONE_DBL_MAX_FAILURES) {
+      return false;
+    }
+  }
+
+  if (this->uploadPos >= words) {
+    if (this->buffer == NULL) tryOrReturnFalse (this->sink(offset, this->staging, words));
+    w->state = STONE_DBL_WINDOW_FREE;
+    this->chunksDone++;
+    this->nextTransfer++;
+    return true;
+  }
+  this->uploadPiece = words - this->uploadPos;
+  if (this->uploadPiece > STONE_VAR_READ_MAX_WORDS) this->uploadPiece = STONE_VAR_READ_MAX_WORDS;
+  this->uploadHandle = this->lcd->requestVariableRead(this->windowVP(this->nextTransfer) + this->uploadPos,
+                                                      &dest[this->uploadPos], this->uploadPiece);
+  return true;
+}
+
+// Waits for the reads still in flight, so they don't write into the buffers
+// after the transfer is over and their slots are released.
+void StoneLCDDatabase::releaseReads() {
+  while (this->pollHandle >= 0 && this->lcd->getReadStatus(this->pollHandle) == STONE_READ_PENDING);
+  while (this->uploadHandle >= 0 && this->lcd->getReadStatus(this->uploadHandle) == STONE_READ_PENDING);
+  this->pollHandle = -1;
+  this->uploadHandle = -1;
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+void StoneLCDDatabase::setPollIntervalMs(uint16_t ms) {
+  this->pollIntervalMs = ms;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+uint8_t StoneLCDDatabase::getStatus() {
+  return this->status;
+}
+
+uint32_t StoneLCDDatabase::getWordsDone() {
+  uint32_t done = this->chunksDone * STONE_DBL_WINDOW_WORDS;
+  return done > this->totalWords ? this->totalWords : done;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// Transfers start right away and are carried on by update(). data/dest must
+// stay valid until the transfer is over. address is the database address as
+// written to STONE_REG_DBL_ADDRESS; each chunk advances it by its word count.
+boolean StoneLCDDatabase::beginWrite(uint32_t address, uint16_t *data, uint32_t words) {
+  if (data == NULL) return false;
+  tryOrReturnFalse (this->begin(STONE_DBL_MODE_WRITE, address, words));
+  this->buffer = data;
+  this->source = NULL;
+  return this->update() != STONE_DBL_FAILED;
+}
+
+boolean StoneLCDDatabase::beginWrite(uint32_t address, uint32_t words, StoneLCDDBLSource callback) {
+  if (callback == NULL) return false;
+  tryOrReturnFalse (this->begin(STONE_DBL_MODE_WRITE, address, words));
+  this->buffer = NULL;
+  this->source = callback;
+  return this->update() != STONE_DBL_FAILED;
+}
+
+boolean StoneLCDDatabase::beginRead(uint32_t address, uint16_t *dest, uint32_t words) {
+  if (dest == NULL) return false;
+  tryOrReturnFalse (this->begin(STONE_DBL_MODE_READ, address, words));
+  this->buffer = dest;
+  this->sink = NULL;
+  return this->update() != STONE_DBL_FAILED;
+}
+
+boolean StoneLCDDatabase::beginRead(uint32_t address, uint32_t words, StoneLCDDBLSink callback) {
+  if (callback == NULL) return false;
+  tryOrReturnFalse (this->begin(STONE_DBL_MODE_READ, address, words));
+  this->buffer = NULL;
+  this->sink = callback;
+  return this->update() != STONE_DBL_FAILED;
+}
+
+// Call this often (e.g. from loop()) while a transfer is running. It never
+// waits for the display. Returns the transfer status.
+uint8_t StoneLCDDatabase::update() {
+  boolean ok;
+
+  if (this->status != STONE_DBL_BUSY) return this->status;
+  ok = this->checkOperation();
+  if (ok) ok = (this->mode == STONE_DBL_MODE_WRITE) ? this->stageChunk() : this->uploadChunk();
+  if (ok) ok = this->startOperation();
+
+  if (!ok) {
+    this->releaseReads();
+    this->status = STONE_DBL_FAILED;
+  } else if (this->chunksDone >= this->chunkCount) {
+    this->status = STONE_DBL_DONE;
+  }
+  return this->status;
+}
+
+// Runs the transfer to the end
+uint8_t StoneLCDDatabase::wait() {
+  while (this->update() == STONE_DBL_BUSY);
+  return this->status;
+}
@@ -0,0 +1,122 @@
+// ************************************************
+// StoneLCDDatabase.h                            **
+// ***************************************************************************
+/* Header for StoneLCDDatabase; non-blocking bulk transfers between the host
+ * and the flash database (DBL) of Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_DATABASE_H__
+#define _STONE_LCD_DATABASE_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Words moved by each database operation. Two VP windows of this size are
+// used, and callback transfers keep one chunk in RAM.
+#ifndef STONE_DBL_WINDOW_WORDS
+#define STONE_DBL_WINDOW_WORDS          32
+#endif
+
+#define STONE_DBL_DEFAULT_POLL_INTERVAL 2   // ms between completion checks
+#define STONE_DBL_MAX_FAILURES          3   // Failed checks/reads in a row before giving up
+
+// Value of STONE_REG_EN_DBL_OP while an operation runs
+#define STONE_DBL_OP_START              0x5A
+
+// --- STONE_REG_DBL_OP_MODE values ----------------------------
+#define STONE_DBL_MODE_WRITE            0x50 // VP -> flash
+#define STONE_DBL_MODE_READ             0xA0 // Flash -> VP
+
+// --- Transfer status -----------------------------------------
+#define STONE_DBL_IDLE                  0
+#define STONE_DBL_BUSY                  1
+#define STONE_DBL_DONE                  2
+#define STONE_DBL_FAILED                3
+
+// --- VP window states ----------------------------------------
+#define STONE_DBL_WINDOW_FREE           0
+#define STONE_DBL_WINDOW_STAGED         1 // Write: data sent to the window, waiting for its operation
+#define STONE_DBL_WINDOW_BUSY           2 // Database operation running on it
+#define STONE_DBL_WINDOW_LOADED         3 // Read: data in the window, waiting to be read
+#define STONE_DBL_WINDOW_UPLOADING      4 // Read: window being read by the host
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+// Callbacks for transfers that don't fit in RAM. offset is the position (in
+// words) of the chunk within the whole transfer. Return false to abort.
+typedef boolean (*StoneLCDDBLSource)(uint32_t offset, uint16_t *dst, uint16_t words);
+typedef boolean (*StoneLCDDBLSink)(uint32_t offset, uint16_t *src, uint16_t words);
+
+typedef struct {
+  uint8_t  state;
+  uint32_t chunk;
+} StoneLCDDBLWindow;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                      S t o n e L C D D a t a b a s e                   ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDDatabase {
+private:
+  StoneLCD *lcd;
+  uint16_t vpBase;
+  uint16_t pollIntervalMs;
+  uint8_t  status;
+  uint8_t  mode;
+  uint32_t flashAddr;
+  uint32_t chunkCount;
+  uint32_t totalWords;
+  uint32_t nextTransfer;   // Next chunk to move between host and window
+  uint32_t nextOp;         // Next chunk to move between window and flash
+  uint32_t chunksDone;
+  uint16_t *buffer;
+  StoneLCDDBLSource source;
+  StoneLCDDBLSink   sink;
+  uint16_t staging[STONE_DBL_WINDOW_WORDS];
+  StoneLCDDBLWindow windows[2];
+
+  int8_t   busyWindow;     // Window with an operation running, or -1
+  int8_t   pollHandle;
+  uint8_t  opFlag;         // Last value read from STONE_REG_EN_DBL_OP
+  unsigned long lastPollAt;
+  int8_t   uploadHandle;
+  uint16_t uploadPos, uploadPiece;
+  uint8_t  failures;
+
+  boolean  begin(uint8_t opMode, uint32_t address, uint32_t words);
+  uint16_t chunkWords(uint32_t chunk);
+  uint16_t windowVP(uint32_t chunk);
+  boolean  checkOperation();
+  boolean  startOperation();
+  boolean  stageChunk();
+  boolean  uploadChunk();
+  void     releaseReads();
+
+public:
+  StoneLCDDatabase(StoneLCD *display, uint16_t windowVPAddr);
+
+  void setPollIntervalMs(uint16_t ms);
+
+  boolean beginWrite(uint32_t address, uint16_t *data, uint32_t words);
+  boolean beginWrite(uint32_t address, uint32_t words, StoneLCDDBLSource callback);
+  boolean beginRead(uint32_t address, uint16_t *dest, uint32_t words);
+  boolean beginRead(uint32_t address, uint32_t words, StoneLCDDBLSink callback);
+
+  uint8_t  update();
+  uint8_t  wait();
+  uint8_t  getStatus();
+  uint32_t getWordsDone();
+};
+#endif
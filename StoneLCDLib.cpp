@@ -21,11 +21,63 @@
 #define constraint(v, minV, maxV)   minVal(v, maxVal(v, maxV))
 #define wordFromBytes(h,l)          ((h<<8) | (l))
 
+// Bytes of a frame that make it to the event queue
+#define STONE_EVENT_STORED_BYTES    (STONE_EVENT_BUFFER_SIZE < STONE_RX_BUFFER_SIZE ? STONE_EVENT_BUFFER_SIZE : STONE_RX_BUFFER_SIZE)
+
+#if STONE_LCD_STATS
+#define statsAdd(field, n)          this->stats.field += (n)
+#define statsCmd(field, cmd)        if ((uint8_t)((cmd) - 0x80) < STONE_STATS_CMD_COUNT) this->stats.field[(cmd) - 0x80]++
+#else
+#define statsAdd(field, n)
+#define statsCmd(field, cmd)
+#endif
+
 /*############################################################################
  *##                                                                        ##
  *##                       A U X   F U N C T I O N S                        ##
  *##                                                                        ##
  *############################################################################*/
+// CRC16 (Modbus polynomial, 0xA001 reflected), as used by STONE displays.
+static const uint16_t CRC16Table[256] PROGMEM = {
+  0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+  0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+  0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+  0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+  0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+  0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+  0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+  0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+  0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+  0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+  0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+  0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+  0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+  0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+  0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+  0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+  0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+  0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+  0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+  0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+  0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+  0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+  0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+  0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+  0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+  0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+  0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+  0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+  0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+  0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+  0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+  0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+// Running this over a frame body *including* its CRC (low byte first) gives 0
+uint16_t CRC16Update (uint16_t crc, uint8_t b){
+  return (crc >> 8) ^ pgm_read_word(&CRC16Table[(crc ^ b) & 0xff]);
+}
+
 uint8_t BCDEncode (uint8_t v){
   uint8_t decHi = v / 10;
   uint8_t decLo = v - (10*decHi);
@@ -38,6 +90,103 @@ uint8_t BCDDecode (uint8_t v){
   return lsn + ((hsn<<3) + hsn + hsn); // lsn + 10*hsn . We are doing the " x10" multiplication by fast shifted multiplication x8 + 2 times the value.
 }
 
+// Days before the first of each month, in a non-leap year
+static const uint16_t DaysBeforeMonth[12] PROGMEM = {
+  0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+// Decodes a STONE_STATUS_REG_BLOCK_SIZE bytes copy of registers 0x00 - 0x0F.
+// Useful with requestRegisterRead() when polling several displays.
+void decodeStatus (const uint8_t *regs, StoneLCDStatus *dst){
+  dst->version      = regs[STONE_REG_VERSION];
+  dst->backlight    = regs[STONE_REG_LED_NOW];
+  dst->buzzerTime   = regs[STONE_REG_BZ_TIME];
+  dst->pageId       = wordFromBytes(regs[STONE_REG_PIC_ID], regs[STONE_REG_PIC_ID + 1]);
+  dst->touchFlag    = regs[STONE_REG_TP_FLAG];
+  dst->touchStatus  = regs[STONE_REG_TP_STATUS];
+  dst->touchX       = wordFromBytes(regs[STONE_REG_TP_POSITION], regs[STONE_REG_TP_POSITION + 1]);
+  dst->touchY       = wordFromBytes(regs[STONE_REG_TP_POSITION + 2], regs[STONE_REG_TP_POSITION + 3]);
+  dst->touchEnabled = regs[STONE_REG_TPC_ENABLE];
+  dst->runHours     = BCDDecode(regs[STONE_REG_RUNTIME]) * 100 + BCDDecode(regs[STONE_REG_RUNTIME + 1]);
+  dst->runMinutes   = BCDDecode(regs[STONE_REG_RUNTIME + 2]);
+  dst->runSeconds   = BCDDecode(regs[STONE_REG_RUNTIME + 3]);
+}
+
+// Decodes the header of a frame (from its cmd byte on, frameLen bytes long,
+// of which only the first "stored" were kept) and points dst to its payload.
+// Returns false if the frame is malformed: unknown command, or a length that
+// doesn't match its contents. A frame that didn't fit is not an error, but
+// dst->truncated is set.
+boolean decodeFrame (const uint8_t *frame, uint8_t frameLen, uint8_t stored, StoneLCDFrame *dst){
+  uint8_t header, payload;
+  boolean ok = true;
+
+  dst->cmd = frame[0];
+  dst->address = 0;
+  dst->count = 0;
+  dst->data = frame;
+  dst->len = 0;
+  dst->truncated = false;
+  switch (dst->cmd) {
+    case STONE_CMD_REGISTER_WRITE:   // cmd (1) + address (1) + bytes
+    case STONE_CMD_REGISTER_READ:    // cmd (1) + address (1) + length (1) + bytes
+    case STONE_CMD_CURVE_BUFFER_WRITE: // cmd (1) + channel mask (1) + words
+      header = (dst->cmd == STONE_CMD_REGISTER_READ) ? 3 : 2;
+      break;
+    case STONE_CMD_VARIABLE_WRITE:   // cmd (1) + address (2) + words
+      header = 3;
+      break;
+    case STONE_CMD_VARIABLE_READ:    // cmd (1) + address (2) + length (1) + words
+      header = 4;
+      break;
+    default:
+      return false;
+  }
+  if (frameLen < header || stored < header) return false;
+  if (stored > frameLen) stored = frameLen;
+
+  payload = frameLen - header;
+  dst->data = frame + header;
+  dst->len = stored - header;
+  dst->truncated = (stored < frameLen);
+  dst->address = (header == 2 || dst->cmd == STONE_CMD_REGISTER_READ) ? frame[1] : wordFromBytes(frame[1], frame[2]);
+
+  switch (dst->cmd) {
+    case STONE_CMD_REGISTER_WRITE:
+      dst->count = payload;
+      break;
+    case STONE_CMD_REGISTER_READ:
+      dst->count = frame[2];
+      ok = (payload == dst->count);
+      break;
+    case STONE_CMD_VARIABLE_READ:
+      dst->count = frame[3];
+      ok = (payload == (dst->count << 1));
+      break;
+    default:
+      dst->count = payload >> 1;
+      ok = !(payload & 1);
+      break;
+  }
+  return ok;
+}
+
+// Returns a mask of the STONE_STATUS_xxx fields that differ between a and b
+uint8_t compareStatus (const StoneLCDStatus *a, const StoneLCDStatus *b){
+  uint8_t changed = 0;
+
+  if (a->version != b->version)           changed |= STONE_STATUS_VERSION;
+  if (a->backlight != b->backlight)       changed |= STONE_STATUS_BACKLIGHT;
+  if (a->buzzerTime != b->buzzerTime)     changed |= STONE_STATUS_BUZZER;
+  if (a->pageId != b->pageId)             changed |= STONE_STATUS_PAGE;
+  if (a->touchFlag != b->touchFlag || a->touchStatus != b->touchStatus ||
+      a->touchX != b->touchX || a->touchY != b->touchY) changed |= STONE_STATUS_TOUCH;
+  if (a->touchEnabled != b->touchEnabled) changed |= STONE_STATUS_TOUCH_ENABLE;
+  if (a->runHours != b->runHours || a->runMinutes != b->runMinutes ||
+      a->runSeconds != b->runSeconds)     changed |= STONE_STATUS_RUNTIME;
+  return changed;
+}
+
 
 /*############################################################################
  *##                                                                        ##
@@ -53,6 +202,9 @@ StoneLCDDateTime::StoneLCDDateTime(uint16_t y, uint8_t m, uint8_t d) {
   this->setMonth(m);
   this->setDay(d);
   this->setWeek(0); // Automatic
+  this->setHour(0);
+  this->setMinutes(0);
+  this->setSeconds(0);
 }
 
 StoneLCDDateTime::StoneLCDDateTime(uint16_t y, uint8_t m, uint8_t d, uint8_t w, uint8_t h, uint8_t mm, uint8_t ss) {
@@ -66,7 +218,13 @@ StoneLCDDateTime::StoneLCDDateTime(uint16_t y, uint8_t m, uint8_t d, uint8_t w,
 }
 
 StoneLCDDateTime::StoneLCDDateTime() {
-  StoneLCDDateTime (2000, 1, 1, 0, 0, 0, 0);
+  this->year = 0;
+  this->month = 1;
+  this->day = 1;
+  this->week = 0;
+  this->hour = 0;
+  this->minutes = 0;
+  this->seconds = 0;
 }
 
 // ****************************************************
@@ -145,6 +303,50 @@ uint8_t StoneLCDDateTime::getBCD(uint8_t *destBuffer) {
   return STONE_DATETIME_BDC_BUFFER_SIZE;
 }
 
+// Unix time (seconds since 1970-01-01 00:00:00)
+uint32_t StoneLCDDateTime::getEpoch(){
+  uint32_t days;
+
+  // Leap years between 2000 and 2099 are the ones divisible by 4
+  days = (uint32_t)this->year * 365 + ((this->year + 3) >> 2);
+  days += pgm_read_word(&DaysBeforeMonth[this->month - 1]) + this->day - 1;
+  if (this->month > 2 && (this->year & 3) == 0) days++;
+  return STONE_EPOCH_2000 + days * 86400UL + this->hour * 3600UL + this->minutes * 60U + this->seconds;
+}
+
+// Times before 2000 are taken as 2000-01-01 00:00:00. The day of the week
+// is also set, with 0 = Sunday.
+void StoneLCDDateTime::setFromEpoch(uint32_t epoch){
+  uint32_t t = epoch > STONE_EPOCH_2000 ? epoch - STONE_EPOCH_2000 : 0;
+  uint16_t days, monthStart;
+  uint8_t y, m, leap;
+
+  this->seconds = t % 60;
+  t /= 60;
+  this->minutes = t % 60;
+  t /= 60;
+  this->hour = t % 24;
+  days = t / 24;
+  this->week = (days + 6) % 7;          // 2000-01-01 was a Saturday
+
+  // 1461 days in every 4 years, starting with a leap one
+  y = (days / 1461) << 2;
+  days %= 1461;
+  while (days >= (uint16_t)((y & 3) == 0 ? 366 : 365)) {
+    days -= (y & 3) == 0 ? 366 : 365;
+    y++;
+  }
+  leap = ((y & 3) == 0) ? 1 : 0;
+  for (m = 11; m > 0; m--) {
+    monthStart = pgm_read_word(&DaysBeforeMonth[m]) + (m >= 2 ? leap : 0);
+    if (days >= monthStart) break;
+  }
+  monthStart = pgm_read_word(&DaysBeforeMonth[m]) + (m >= 2 ? leap : 0);
+  this->year = y > 99 ? 99 : y;
+  this->month = m + 1;
+  this->day = days - monthStart + 1;
+}
+
 void StoneLCDDateTime::setFromBCDBuffer(uint8_t *srcBuffer){
   this->setYear(2000 + BCDDecode(srcBuffer[0]));
   this->setMonth(BCDDecode(srcBuffer[1]));
@@ -162,16 +364,58 @@ void StoneLCDDateTime::setFromBCDBuffer(uint8_t *srcBuffer){
  *############################################################################*/
 void  StoneLCD::clearInputStream(){
   while (this->ioBytesAvailable() > 0) this->readIOStream();
+  this->resetParser();
+  this->eventCount = 0;
 }
 
 
 // ****************************************************
 // ** Constructor
 // ****************************************************
-StoneLCD::StoneLCD (Stream *ioPort, uint8_t cmdHi, uint8_t cmdLo) {
+StoneLCD::StoneLCD (Stream *ioPort, uint8_t cmdHi, uint8_t cmdLo, boolean crcMode) {
+  uint8_t i;
+
 	this->interface = ioPort;
 	this->cmdFrameLSB = cmdLo;
 	this->cmdFrameHSB = cmdHi;
+  this->useCRC = crcMode;
+  this->crcErrors = 0;
+  this->txCount = 0;
+  this->txPriority = STONE_TX_NORMAL;
+  this->txHold = false;
+#if STONE_TX_QUEUE_SIZE > 0
+  this->txQueued = false;
+  this->txHandle = -1;
+  this->txQueueUsed = 0;
+  this->txFrameCount = 0;
+  this->txCurrent = -1;
+#endif
+  this->batching = false;
+  this->batchCount = 0;
+#if STONE_VAR_CACHE_SIZE > 0
+  this->cacheCount = 0;
+  this->cacheHits = 0;
+  this->cacheMisses = 0;
+#endif
+  this->baudRate = 0;
+  this->maxRetries = 0;
+  this->lastError = STONE_ERR_NONE;
+  this->hasRtt = false;
+  this->srttUs = 0;
+  this->rttVarUs = 0;
+  this->readSeq = 0;
+  for (i = 0; i < STONE_MAX_PENDING_READS; i++) {
+    this->pendingReads[i].status = STONE_READ_FREE;
+    this->strays[i].cmd = 0;
+  }
+  this->eventHead = 0;
+  this->eventCount = 0;
+  this->droppedEvents = 0;
+  this->resetStats();
+  this->dispatching = false;
+  this->handlerCount = 0;
+  this->defaultHandler = NULL;
+  this->resetParser();
 }
 
 // ****************************************************
@@ -187,49 +431,892 @@ uint8_t StoneLCD::readIOStream(){
   return this->interface->read();
 }
 
-uint8_t StoneLCD::waitAndReadIOStream(){
-  long startTime = millis();
-  while (millis() - startTime < this->timeOutMs) {
-    if (this->ioBytesAvailable() > 0) return this->readIOStream();
+void StoneLCD::resetParser(){
+  this->rxState = STONE_RX_WAIT_HEADER_HI;
+  this->rxLen = 0;
+  this->rxCount = 0;
+}
+
+// Feeds back the bytes consumed by a header that turned out to be invalid, so
+// a real frame start hidden among them is not lost.
+void StoneLCD::resyncParser(uint8_t *pending, uint8_t pendingLen){
+  uint8_t i;
+  statsAdd(resyncs, 1);
+  statsAdd(garbageBytes, 1); // The byte taken as a header
+  this->resetParser();
+  for (i = 0; i < pendingLen; i++) this->parseIOByte(pending[i]);
+}
+
+// Advances the RX state machine by one byte. Returns true once a complete
+// frame is in rxBuffer.
+boolean StoneLCD::parseIOByte(uint8_t b){
+  uint8_t pending[3];
+
+  switch (this->rxState) {
+    case STONE_RX_WAIT_HEADER_HI:
+      if (b == this->cmdFrameHSB) {
+        this->rxState = STONE_RX_WAIT_HEADER_LO;
+      } else {
+        statsAdd(garbageBytes, 1);
+      }
+      break;
+
+    case STONE_RX_WAIT_HEADER_LO:
+      if (b == this->cmdFrameLSB) {
+        this->rxState = STONE_RX_WAIT_LENGTH;
+      } else {
+        statsAdd(garbageBytes, 1);
+        if (b != this->cmdFrameHSB) this->rxState = STONE_RX_WAIT_HEADER_HI;
+      }
+      break;
+
+    case STONE_RX_WAIT_LENGTH:
+      // Every frame carries at least a cmd and one more byte (plus the CRC)
+      if (b < (this->useCRC ? 4 : 2)) {
+        pending[0] = this->cmdFrameLSB;
+        pending[1] = b;
+        this->resyncParser(pending, 2);
+        break;
+      }
+      this->rxLen = b;
+      this->rxCount = 0;
+      this->rxState = STONE_RX_WAIT_CMD;
+      break;
+
+    case STONE_RX_WAIT_CMD:
+      if (b < STONE_CMD_REGISTER_WRITE || b > STONE_CMD_CURVE_BUFFER_WRITE) {
+        pending[0] = this->cmdFrameLSB;
+        pending[1] = this->rxLen;
+        pending[2] = b;
+        this->resyncParser(pending, 3);
+        break;
+      }
+      this->rxBuffer[0] = b;
+      this->rxCount = 1;
+      this->rxCRC = CRC16Update(0xFFFF, b);
+      this->rxState = STONE_RX_WAIT_BODY;
+      break;
+
+    case STONE_RX_WAIT_BODY:
+      if (this->rxCount < STONE_RX_BUFFER_SIZE) this->rxBuffer[this->rxCount] = b;
+      this->rxCount++;
+      if (this->useCRC) this->rxCRC = CRC16Update(this->rxCRC, b);
+      if (this->rxCount >= this->rxLen) {
+        this->rxState = STONE_RX_WAIT_HEADER_HI;
+        if (this->useCRC) {
+          if (this->rxCRC != 0) {
+            this->crcErrors++;
+            statsAdd(crcErrors, 1);
+            this->failOldestRead(this->rxBuffer[0]);
+            return false;
+          }
+          this->rxLen -= 2; // From here on, frames look the same with or without CRC
+        }
+        statsCmd(rxFrames, this->rxBuffer[0]);
+        return true;
+      }
+      break;
   }
-  return 0;
+  return false;
 }
 
-// Pending: CRC
-boolean StoneLCD::sendCmdFrameStart (uint8_t cmd, uint8_t len){
-  if (this->interface != NULL){
-    this->interface->write(this->cmdFrameHSB);
-    this->interface->write(this->cmdFrameLSB);
-    this->interface->write(len);
-    this->interface->write(cmd);
-    return true;
+// Consumes only the bytes already waiting in the stream. Stops right after a
+// complete frame so the bytes of the next one stay in the stream.
+boolean StoneLCD::receiveFrame(){
+  while (this->ioBytesAvailable() > 0) {
+    statsAdd(rxBytes, 1);
+    if (this->parseIOByte(this->readIOStream())) return true;
   }
   return false;
 }
 
-boolean StoneLCD::sendByte (uint8_t b){
-  if (this->interface != NULL) {
-    this->interface->write(b);
-    return true;
+#if STONE_LCD_STATS
+void StoneLCD::recordRoundTrip (unsigned long us){
+  uint8_t bucket = 0;
+
+  us >>= 8;
+  while (us > 0 && bucket < STONE_STATS_RTT_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  this->stats.rttHistogram[bucket]++;
+}
+#endif
+
+#if STONE_TX_QUEUE_SIZE > 0
+// Writes (part of) the next queued frame: the oldest one of the highest
+// priority, unless one was already started, which is always finished first.
+// Without block only what fits in the port's buffer is written. Returns true
+// when a whole frame was sent.
+boolean StoneLCD::sendQueuedFrame (boolean block){
+  uint8_t i, n;
+  int room;
+  StoneLCDTxFrame *f;
+  StoneLCDPendingRead *pr;
+
+  if (this->txFrameCount == 0) return false;
+  room = block ? 255 : this->interface->availableForWrite();
+  if (room <= 0) return false;
+  if (this->txCurrent < 0) {
+    this->txCurrent = 0;
+    for (i = 1; i < this->txFrameCount; i++) {
+      if (this->txFrames[i].priority < this->txFrames[this->txCurrent].priority) this->txCurrent = i;
+    }
+    this->txSent = 0;
+  }
+  f = &this->txFrames[this->txCurrent];
+  n = f->len - this->txSent;
+  if (n > room) n = room;
+  this->interface->write(&this->txQueue[f->offset + this->txSent], n);
+  statsAdd(txBytes, n);
+  this->txSent += n;
+  if (this->txSent < f->len) return false;
+
+  // A read's deadline counts from the moment its request is out
+  if (f->handle >= 0) {
+    pr = &this->pendingReads[f->handle];
+    pr->queued = false;
+    pr->sentAt = millis();
+    pr->sentAtUs = micros();
+  }
+  this->removeQueuedFrame(this->txCurrent);
+  this->txCurrent = -1;
+  return true;
+}
+
+void StoneLCD::removeQueuedFrame (uint8_t index){
+  uint8_t i, offset = this->txFrames[index].offset, len = this->txFrames[index].len;
+
+  memmove(&this->txQueue[offset], &this->txQueue[offset + len], this->txQueueUsed - offset - len);
+  this->txQueueUsed -= len;
+  for (i = index; i + 1 < this->txFrameCount; i++) {
+    this->txFrames[i] = this->txFrames[i + 1];
+    this->txFrames[i].offset -= len;
+  }
+  this->txFrameCount--;
+  if (this->txCurrent > (int8_t)index) this->txCurrent--;
+}
+
+// A variable write that hasn't started to go out is dropped when a newer
+// one for the same address and length is queued, since it would be
+// overwritten anyway. Register writes are always kept, as some of them
+// trigger actions (e.g. STONE_REG_PLAY_CONTROL toggles playback).
+void StoneLCD::dropSupersededFrames (){
+  uint8_t i, last = this->txFrameCount - 1;
+  uint8_t *frame = &this->txQueue[this->txFrames[last].offset];
+
+  if (frame[3] != STONE_CMD_VARIABLE_WRITE) return;      // Header (2) + length (1) + cmd
+  for (i = last; i-- > 0;) {
+    if ((int8_t)i == this->txCurrent || this->txFrames[i].len != this->txFrames[last].len) continue;
+    // Header, length, cmd and address
+    if (memcmp(&this->txQueue[this->txFrames[i].offset], frame, 6) != 0) continue;
+    this->removeQueuedFrame(i);
+    last--;
+    frame = &this->txQueue[this->txFrames[last].offset];
+  }
+}
+#endif
+
+// Fails if the stream took fewer bytes than it was given
+boolean StoneLCD::flushTxBuffer (){
+  size_t written = 0;
+  uint8_t count = this->txCount;
+
+  if (this->interface == NULL) return false;
+  if (count > 0) written = this->interface->write(this->txBuffer, count);
+  statsAdd(txBytes, written);
+  this->txCount = 0;
+  return written == count;
+}
+
+// Time the given number of bytes take on the wire (8N1, so 10 bits each),
+// or 0 if the baud rate isn't known.
+unsigned long StoneLCD::wireTimeUs (uint16_t bytes){
+  if (this->baudRate < 100) return 0;
+  return (unsigned long)bytes * 100000UL / (this->baudRate / 100);
+}
+
+// Size of a read request (reply = false) or of its reply, header and CRC
+// included.
+uint16_t StoneLCD::readFrameBytes (uint8_t cmd, uint8_t len, boolean reply){
+  uint16_t bytes = this->useCRC ? 2 + 1 + 2 : 2 + 1;       // Header (2) + length (1) + CRC (2)
+
+  bytes += (cmd == STONE_CMD_REGISTER_READ) ? 3 : 4;       // cmd (1) + address (1 or 2) + length (1)
+  if (reply) bytes += (cmd == STONE_CMD_REGISTER_READ) ? len : (uint16_t)len << 1;
+  return bytes;
+}
+
+// Deadline for a read that was just sent. Replies come back in order, so
+// the ones still expected for earlier reads count too (as well as its own). Without a baud rate
+// (or before the first reply) the configured timeout is used as is.
+unsigned long StoneLCD::readTimeoutMs (int8_t handle){
+  int8_t h;
+  uint16_t bytes;
+  long turnaround;
+  StoneLCDPendingRead *pr = &this->pendingReads[handle];
+
+  if (this->baudRate == 0 || !this->hasRtt) return this->timeOutMs;
+  bytes = this->readFrameBytes(pr->cmd, pr->len, false);
+  for (h = 0; h < STONE_MAX_PENDING_READS; h++) {
+    if (this->pendingReads[h].status != STONE_READ_PENDING) continue;
+    bytes += this->readFrameBytes(this->pendingReads[h].cmd, this->pendingReads[h].len, true);
+  }
+  turnaround = (this->srttUs + 4 * this->rttVarUs) / 1000 + STONE_TIMEOUT_MARGIN_MS;
+  if (turnaround < STONE_MIN_TIMEOUT_MS) turnaround = STONE_MIN_TIMEOUT_MS;
+  if (turnaround > this->timeOutMs) turnaround = this->timeOutMs;
+  return this->wireTimeUs(bytes) / 1000 + 1 + turnaround;
+}
+
+// Updates the turnaround estimate (round trip minus wire time) with a read
+// that just completed, as TCP does (RFC 6298). Replies to retried requests
+// are skipped, since there's no telling which request they answer.
+void StoneLCD::updateRoundTrip (StoneLCDPendingRead *pr){
+  long sample, err;
+
+  if (pr->attempts > 0) return;
+  sample = (long)(micros() - pr->sentAtUs);
+  sample -= (long)this->wireTimeUs(this->readFrameBytes(pr->cmd, pr->len, false) + this->readFrameBytes(pr->cmd, pr->len, true));
+  if (sample < 0) sample = 0;
+  if (!this->hasRtt) {
+    this->srttUs = sample;
+    this->rttVarUs = sample >> 1;
+    this->hasRtt = true;
+    return;
+  }
+  err = sample - this->srttUs;
+  this->srttUs += err >> 3;
+  if (err < 0) err = -err;
+  this->rttVarUs += (err - this->rttVarUs) >> 2;
+}
+
+boolean StoneLCD::sendReadRequest (uint8_t cmd, uint16_t address, uint8_t len){
+  if (cmd == STONE_CMD_REGISTER_READ) {
+    tryOrReturnFalse (this->beginFrame(cmd, 3));   // cmd (1) + address (1) + bytes to read (1 byte)
+    this->frameByte((uint8_t)address);
+  } else {
+    tryOrReturnFalse (this->beginFrame(cmd, 4));   // cmd (1) + address (2) + words to read (1 byte)
+    this->frameWord(address);
+  }
+  this->frameByte(len);
+  return this->endFrame();
+}
+
+// Sends a timed out request again, with twice the time to answer. The
+// original reply may still arrive, so the extra one is remembered as a
+// stray to drop.
+boolean StoneLCD::retryRead (int8_t handle){
+  StoneLCDPendingRead *pr = &this->pendingReads[handle];
+  StoneLCDStrayReply *stray = &this->strays[handle];
+  boolean ok;
+
+#if STONE_TX_QUEUE_SIZE > 0
+  pr->queued = true;
+  this->txHandle = handle;
+#endif
+  ok = this->sendReadRequest(pr->cmd, pr->address, pr->len);
+#if STONE_TX_QUEUE_SIZE > 0
+  this->txHandle = -1;
+#endif
+  tryOrReturnFalse (ok);
+  pr->attempts++;
+  pr->timeoutMs <<= 1;
+  pr->sentAt = millis();
+  pr->sentAtUs = micros();
+  stray->cmd = pr->cmd;
+  stray->len = pr->len;
+  stray->address = pr->address;
+  stray->until = pr->sentAt + pr->timeoutMs;
+  return true;
+}
+
+// True if the frame in rxBuffer is the late second reply to a retried read
+boolean StoneLCD::dropStrayReply (uint8_t cmd, uint16_t address, uint8_t len){
+  uint8_t i;
+  StoneLCDStrayReply *stray;
+
+  for (i = 0; i < STONE_MAX_PENDING_READS; i++) {
+    stray = &this->strays[i];
+    if (stray->cmd == 0) continue;
+    if ((long)(millis() - stray->until) >= 0) {
+      stray->cmd = 0;
+      continue;
+    }
+    if (stray->cmd == cmd && stray->address == address && stray->len == len) {
+      stray->cmd = 0;
+      return true;
+    }
   }
   return false;
 }
 
-boolean StoneLCD::sendWord (uint16_t w){
-  if (this->interface != NULL) {
-    this->interface->write((uint8_t)(w>>8));
-    this->interface->write((uint8_t)(w&0xff));
+// Sends a read request and takes a pending read slot to wait for its reply.
+// Returns the slot (handle) or -1 (see getLastError()).
+int8_t StoneLCD::issueRead (uint8_t cmd, uint16_t address, uint8_t len, void *dest, StoneLCDReadCallback callback){
+  int8_t h;
+  boolean ok;
+  StoneLCDPendingRead *pr;
+
+  if (dest == NULL || len == 0) {
+    this->lastError = STONE_ERR_INVALID_ARG;
+    return -1;
+  }
+  for (h = 0; h < STONE_MAX_PENDING_READS; h++) {
+    if (this->pendingReads[h].status == STONE_READ_FREE) break;
+  }
+  if (h >= STONE_MAX_PENDING_READS) {
+    this->lastError = STONE_ERR_NO_SLOT;
+    return -1;
+  }
+
+  // Queued writes must land before the read
+  if (this->batchCount > 0 && !this->sendBatch()) {
+    this->lastError = STONE_ERR_SEND;
+    return -1;
+  }
+  pr = &this->pendingReads[h];
+#if STONE_TX_QUEUE_SIZE > 0
+  pr->queued = true;
+  this->txHandle = h;
+#endif
+  ok = this->sendReadRequest(cmd, address, len);
+#if STONE_TX_QUEUE_SIZE > 0
+  this->txHandle = -1;
+#endif
+  if (!ok) {
+    this->lastError = STONE_ERR_SEND;
+    return -1;
+  }
+
+  pr->seq = this->readSeq++;
+  pr->cmd = cmd;
+  pr->address = address;
+  pr->len = len;
+  pr->dest = dest;
+  pr->attempts = 0;
+  pr->error = STONE_ERR_NONE;
+  pr->sentAt = millis();
+  pr->sentAtUs = micros();
+  pr->callback = callback;
+  pr->status = STONE_READ_PENDING;
+  pr->timeoutMs = this->readTimeoutMs(h);
+  return h;
+}
+
+// Reads with a callback release their slot right away; the others keep their
+// status until it's collected through getReadStatus().
+void StoneLCD::completeRead (int8_t handle, uint8_t status, uint8_t error){
+  StoneLCDPendingRead *pr = &this->pendingReads[handle];
+  StoneLCDReadCallback callback = pr->callback;
+
+  pr->status = status;
+  pr->error = error;
+  if (callback != NULL) {
+    pr->status = STONE_READ_FREE;
+    this->lastError = error;
+    callback(handle, status == STONE_READ_DONE);
+  }
+}
+
+// A corrupted frame that arrives while reads of the same kind are pending is
+// most likely the reply to the oldest of them, so that one fails right away
+// instead of waiting for its timeout.
+void StoneLCD::failOldestRead (uint8_t cmd){
+  int8_t h, oldest = -1;
+
+  for (h = 0; h < STONE_MAX_PENDING_READS; h++) {
+    if (this->pendingReads[h].status != STONE_READ_PENDING || this->pendingReads[h].cmd != cmd) continue;
+#if STONE_TX_QUEUE_SIZE > 0
+    if (this->pendingReads[h].queued) continue;
+#endif
+    if (oldest < 0 || (int8_t)(this->pendingReads[h].seq - this->pendingReads[oldest].seq) < 0) oldest = h;
+  }
+  if (oldest >= 0) this->completeRead(oldest, STONE_READ_FAILED, STONE_ERR_CRC);
+}
+
+// Checks if the frame in rxBuffer is the reply to a pending read, and if so
+// copies its data to the read destination. Replies come back in the same
+// order the requests were sent, so the oldest matching request is used.
+boolean StoneLCD::matchPendingRead (){
+  int8_t h, match = -1;
+  uint8_t r, addrLen, cmd = this->rxBuffer[0];
+  uint16_t address;
+  StoneLCDPendingRead *pr;
+
+  if (cmd == STONE_CMD_REGISTER_READ) {
+    if (this->rxLen < 3) return false;
+    address = this->rxBuffer[1];
+    addrLen = 1;
+  } else if (cmd == STONE_CMD_VARIABLE_READ) {
+    if (this->rxLen < 4) return false;
+    address = wordFromBytes(this->rxBuffer[1], this->rxBuffer[2]);
+    addrLen = 2;
+  } else {
+    return false;
+  }
+
+  for (h = 0; h < STONE_MAX_PENDING_READS; h++) {
+    pr = &this->pendingReads[h];
+    if (pr->status != STONE_READ_PENDING || pr->cmd != cmd || pr->address != address) continue;
+    if (pr->len != this->rxBuffer[1 + addrLen]) continue;
+    if (match < 0 || (int8_t)(pr->seq - this->pendingReads[match].seq) < 0) match = h;
+  }
+  if (match < 0) return this->dropStrayReply(cmd, address, this->rxBuffer[1 + addrLen]);
+
+  pr = &this->pendingReads[match];
+  if (cmd == STONE_CMD_REGISTER_READ) {
+    // cmd (1) + address (1) + requested bytes (1)
+    if (this->rxLen != pr->len + 3 || this->rxLen > STONE_RX_BUFFER_SIZE) {
+      this->completeRead(match, STONE_READ_FAILED, STONE_ERR_BAD_REPLY);
+      return true;
+    }
+    memcpy(pr->dest, &this->rxBuffer[3], pr->len);
+  } else {
+    // cmd (1) + address (2) + requested words (1)
+    if (this->rxLen != (pr->len << 1) + 4 || this->rxLen > STONE_RX_BUFFER_SIZE) {
+      this->completeRead(match, STONE_READ_FAILED, STONE_ERR_BAD_REPLY);
+      return true;
+    }
+    for (r = 0; r < pr->len; r++) {
+      ((uint16_t *)pr->dest)[r] = wordFromBytes(this->rxBuffer[4 + (r<<1)], this->rxBuffer[5 + (r<<1)]);
+      this->updateVariableCache(address + r, ((uint16_t *)pr->dest)[r]);
+    }
+  }
+#if STONE_LCD_STATS
+  this->recordRoundTrip(micros() - pr->sentAtUs);
+#endif
+  this->updateRoundTrip(pr);
+  this->completeRead(match, STONE_READ_DONE);
+  return true;
+}
+
+// Keeps the frame in rxBuffer until the application (or dispatchEvents) takes
+// it. When the queue is full the new frame is dropped and counted.
+void StoneLCD::queueEvent (){
+  uint8_t i, pos, len;
+  uint16_t address;
+  StoneLCDQueuedFrame *evt;
+
+  // Keep shadowed variables in sync with what the display reports
+  if (this->rxBuffer[0] == STONE_CMD_VARIABLE_READ && this->rxLen == 4 + (this->rxBuffer[3]<<1)) {
+    address = wordFromBytes(this->rxBuffer[1], this->rxBuffer[2]);
+    for (i = 0; i < this->rxBuffer[3]; i++) {
+      pos = 4 + (i<<1);
+      if (pos + 1 >= STONE_RX_BUFFER_SIZE) break;
+      this->updateVariableCache(address + i, wordFromBytes(this->rxBuffer[pos], this->rxBuffer[pos + 1]));
+    }
+  }
+
+  if (this->eventCount >= STONE_EVENT_QUEUE_SIZE) {
+    this->droppedEvents++;
+    return;
+  }
+  evt = &this->eventQueue[(this->eventHead + this->eventCount) % STONE_EVENT_QUEUE_SIZE];
+  len = this->rxLen;
+  if (len > STONE_RX_BUFFER_SIZE) len = STONE_RX_BUFFER_SIZE;
+  if (len > STONE_EVENT_BUFFER_SIZE) len = STONE_EVENT_BUFFER_SIZE;
+  evt->frameLen = this->rxLen;
+  memcpy(evt->data, this->rxBuffer, len);
+  this->eventCount++;
+}
+
+// Reads past their deadline are sent again while they have retries left,
+// and fail otherwise.
+void StoneLCD::checkReadTimeouts (){
+  int8_t h;
+  unsigned long now = millis();
+  StoneLCDPendingRead *pr;
+
+  for (h = 0; h < STONE_MAX_PENDING_READS; h++) {
+    pr = &this->pendingReads[h];
+    if (pr->status != STONE_READ_PENDING) continue;
+#if STONE_TX_QUEUE_SIZE > 0
+    if (pr->queued) continue;
+#endif
+    if ((long)(now - pr->sentAt) < (long)pr->timeoutMs) continue;
+    statsAdd(timeouts, 1);
+    if (pr->attempts < this->maxRetries) {
+      if (!this->retryRead(h)) this->completeRead(h, STONE_READ_FAILED, STONE_ERR_SEND);
+    } else {
+      this->completeRead(h, STONE_READ_FAILED, STONE_ERR_TIMEOUT);
+    }
+  }
+}
+
+// Blocks until the read behind the handle completes or times out. Events
+// that arrive in the meantime are queued, not discarded.
+boolean StoneLCD::waitForRead (int8_t handle){
+  uint8_t status;
+
+  if (handle < 0) return false;
+  do {
+    this->poll();
+    status = this->pendingReads[handle].status;
+  } while (status == STONE_READ_PENDING);
+  this->pendingReads[handle].status = STONE_READ_FREE;
+  if (status != STONE_READ_DONE) this->lastError = this->pendingReads[handle].error;
+  return status == STONE_READ_DONE;
+}
+
+// Reads len bytes (registers) or words (variables), split in as many frames
+// as needed. Up to STONE_MAX_PENDING_READS requests are kept in flight, so
+// the display can answer one while the next is being sent. It always waits
+// for every request it issued, even after a failure, since their replies are
+// written to dest.
+boolean StoneLCD::readBlock (uint8_t cmd, uint16_t address, uint8_t *dest, uint16_t len){
+  int8_t inFlight[STONE_MAX_PENDING_READS];
+  int8_t h;
+  uint8_t chunk, first = 0, count = 0;
+  uint8_t maxChunk = (cmd == STONE_CMD_REGISTER_READ) ? STONE_REG_READ_MAX_BYTES : STONE_VAR_READ_MAX_WORDS;
+  uint8_t unitSize = (cmd == STONE_CMD_REGISTER_READ) ? 1 : 2;
+  boolean ok = true;
+
+  while ((ok && len > 0) || count > 0) {
+    if (ok && len > 0 && count < STONE_MAX_PENDING_READS) {
+      chunk = len > maxChunk ? maxChunk : len;
+      h = this->issueRead(cmd, address, chunk, dest, NULL);
+      if (h >= 0) {
+        inFlight[(first + count) % STONE_MAX_PENDING_READS] = h;
+        count++;
+        address += chunk;
+        dest += chunk * unitSize;
+        len -= chunk;
+        continue;
+      }
+      // No slot (others may be in use by async reads) and nothing to wait for
+      if (count == 0) return false;
+    }
+    ok = this->waitForRead(inFlight[first]) && ok;
+    first = (first + 1) % STONE_MAX_PENDING_READS;
+    count--;
+  }
+  // A read that had to wait for a free slot isn't an error
+  if (ok) this->lastError = STONE_ERR_NONE;
+  return ok;
+}
+
+boolean StoneLCD::decodeEvent (StoneLCDQueuedFrame *evt, StoneLCDEvent *dst, uint16_t *dataDest, uint8_t maxLen){
+  uint8_t i;
+  boolean ok;
+  StoneLCDFrame frame;
+
+  ok = decodeFrame(evt->data, evt->frameLen, STONE_EVENT_STORED_BYTES, &frame);
+  dst->cmd = frame.cmd;
+  dst->address = frame.address;
+  dst->dataLen = frame.count;
+
+  // Register frames carry bytes; each one goes to a word of its own
+  if (frame.cmd == STONE_CMD_REGISTER_READ || frame.cmd == STONE_CMD_REGISTER_WRITE) {
+    for (i = 0; i < frame.len && i < maxLen; i++) dataDest[i] = frame.data[i];
+  } else {
+    for (i = 0; i < frame.words() && i < maxLen; i++) dataDest[i] = frame.wordAt(i);
+  }
+  return ok;
+}
+
+// Handlers are kept sorted by their first address and don't overlap, so the
+// candidate is the last entry starting at or before the address.
+StoneLCDEventHandler StoneLCD::findEventHandler (uint16_t address){
+  int8_t lo = 0, hi = this->handlerCount - 1, mid, found = -1;
+
+  while (lo <= hi) {
+    mid = (lo + hi) >> 1;
+    if (this->handlers[mid].first <= address) {
+      found = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  if (found >= 0 && this->handlers[found].last >= address) return this->handlers[found].handler;
+  return this->defaultHandler;
+}
+
+// Hands every queued event to its handler. Handlers may call back into the
+// library (even blocking reads); events received meanwhile are queued and
+// dispatched by the outer loop, not recursively.
+uint8_t StoneLCD::dispatchEvents (){
+  uint8_t count = 0;
+  StoneLCDEvent evt;
+  uint16_t data[STONE_EVENT_MAX_WORDS];
+  StoneLCDQueuedFrame *frame;
+  StoneLCDEventHandler handler;
+
+  if (this->dispatching) return 0;
+  this->dispatching = true;
+  while (this->eventCount > 0) {
+    frame = &this->eventQueue[this->eventHead];
+    this->eventHead = (this->eventHead + 1) % STONE_EVENT_QUEUE_SIZE;
+    this->eventCount--;
+    if (!this->decodeEvent(frame, &evt, data, STONE_EVENT_MAX_WORDS)) continue;
+
+    if (evt.dataLen > STONE_EVENT_MAX_WORDS) evt.dataLen = STONE_EVENT_MAX_WORDS;
+    handler = this->findEventHandler(evt.address);
+    if (handler != NULL) {
+      handler(&evt, data);
+      count++;
+    }
+  }
+  this->dispatching = false;
+  return count;
+}
+
+// len is the frame length without CRC; the CRC bytes are accounted for here
+boolean StoneLCD::beginFrame (uint8_t cmd, uint8_t len){
+#if STONE_TX_QUEUE_SIZE > 0
+  uint16_t total = (this->useCRC ? 2 + 1 + 2 : 2 + 1) + len;   // Header (2) + length (1) + CRC (2)
+#endif
+
+  if (this->interface == NULL) return false;
+#if STONE_TX_QUEUE_SIZE > 0
+  // Frames too big for the queue go right away, so everything queued must
+  // go first. The rest wait until there's room, and must not overtake the
+  // frames held in txBuffer (see runScript) either.
+  if (total <= STONE_TX_QUEUE_SIZE && this->txCount > 0) tryOrReturnFalse (this->flushTxBuffer());
+  this->txQueued = (total <= STONE_TX_QUEUE_SIZE);
+  while (this->txFrameCount > 0 && (!this->txQueued || this->txFrameCount >= STONE_TX_QUEUE_FRAMES ||
+         total > STONE_TX_QUEUE_SIZE - this->txQueueUsed)) {
+    this->sendQueuedFrame(true);
+  }
+  this->txFrameStart = this->txQueueUsed;
+#endif
+  if (!this->txHold) this->txCount = 0;
+  this->frameByte(this->cmdFrameHSB);
+  this->frameByte(this->cmdFrameLSB);
+  this->frameByte(this->useCRC ? len + 2 : len);
+  statsCmd(txFrames, cmd);
+  // The CRC covers everything from the cmd byte on
+  this->txCRC = 0xFFFF;
+  return this->frameByte(cmd);
+}
+
+boolean StoneLCD::frameByte (uint8_t b){
+#if STONE_TX_QUEUE_SIZE > 0
+  if (this->txQueued) {
+    this->txQueue[this->txQueueUsed++] = b;
+    if (this->useCRC) this->txCRC = CRC16Update(this->txCRC, b);
     return true;
   }
-  return false;
+#endif
+  if (this->txCount >= STONE_TX_BUFFER_SIZE) tryOrReturnFalse (this->flushTxBuffer());
+  this->txBuffer[this->txCount++] = b;
+  if (this->useCRC) this->txCRC = CRC16Update(this->txCRC, b);
+  return true;
+}
+
+boolean StoneLCD::frameWord (uint16_t w){
+  tryOrReturnFalse (this->frameByte((uint8_t)(w>>8)));
+  return this->frameByte((uint8_t)(w&0xff));
 }
 
-boolean StoneLCD::sendBuffer (uint8_t *b, byte bufflen){
-  if (this->interface != NULL) {
-    this->interface->write(b, bufflen);
+boolean StoneLCD::frameBuffer (const uint8_t *b, uint8_t bufflen){
+  uint8_t i, chunk;
+#if STONE_TX_QUEUE_SIZE > 0
+  if (this->txQueued) {
+    for (i = 0; i < bufflen; i++) this->frameByte(b[i]);
     return true;
   }
+#endif
+  while (bufflen > 0) {
+    if (this->txCount >= STONE_TX_BUFFER_SIZE) tryOrReturnFalse (this->flushTxBuffer());
+    chunk = STONE_TX_BUFFER_SIZE - this->txCount;
+    if (chunk > bufflen) chunk = bufflen;
+    memcpy(&this->txBuffer[this->txCount], b, chunk);
+    if (this->useCRC) {
+      for (i = 0; i < chunk; i++) this->txCRC = CRC16Update(this->txCRC, b[i]);
+    }
+    this->txCount += chunk;
+    b += chunk;
+    bufflen -= chunk;
+  }
+  return true;
+}
+
+// Appends the CRC, if enabled, and sends the assembled frame with a single
+// write() call (or queues it, see STONE_TX_QUEUE_SIZE)
+boolean StoneLCD::endFrame (){
+  uint16_t crc = this->txCRC;
+#if STONE_TX_QUEUE_SIZE > 0
+  StoneLCDTxFrame *f;
+#endif
+
+  if (this->useCRC) {
+    tryOrReturnFalse (this->frameByte(crc & 0xff));
+    tryOrReturnFalse (this->frameByte(crc >> 8));
+  }
+#if STONE_TX_QUEUE_SIZE > 0
+  if (this->txQueued) {
+    this->txQueued = false;
+    f = &this->txFrames[this->txFrameCount++];
+    f->offset = this->txFrameStart;
+    f->len = this->txQueueUsed - this->txFrameStart;
+    f->priority = this->txPriority;
+    f->handle = this->txHandle;
+    this->dropSupersededFrames();
+    this->drainTxQueue();
+    return true;
+  }
+  if (this->txHandle >= 0) this->pendingReads[this->txHandle].queued = false;
+#endif
+  if (this->txHold) return true;
+  return this->flushTxBuffer();
+}
+
+// Keeps the batch sorted by type and address, so contiguous runs can be sent
+// as a single frame. Writing an address that is already queued just replaces
+// its value.
+boolean StoneLCD::queueBatchWrite (uint8_t isRegister, uint16_t address, uint16_t value){
+  uint8_t i, pos;
+  uint32_t key = ((uint32_t)isRegister << 16) | address;
+  uint32_t entryKey;
+
+  for (pos = 0; pos < this->batchCount; pos++) {
+    entryKey = ((uint32_t)this->batch[pos].isRegister << 16) | this->batch[pos].address;
+    if (entryKey == key) {
+      this->batch[pos].value = value;
+      return true;
+    }
+    if (entryKey > key) break;
+  }
+  if (this->batchCount >= STONE_BATCH_SIZE) {
+    tryOrReturnFalse (this->sendBatch());
+    pos = 0;
+  }
+  for (i = this->batchCount; i > pos; i--) this->batch[i] = this->batch[i - 1];
+  this->batch[pos].isRegister = isRegister;
+  this->batch[pos].address = address;
+  this->batch[pos].value = value;
+  this->batchCount++;
+  return true;
+}
+
+boolean StoneLCD::isBatchQueued (uint8_t isRegister, uint16_t address){
+  uint8_t i;
+
+  for (i = 0; i < this->batchCount; i++) {
+    if (this->batch[i].isRegister == isRegister && this->batch[i].address == address) return true;
+  }
+  return false;
+}
+
+// The cache only learns the values of the runs that were actually sent
+boolean StoneLCD::sendBatch (){
+  uint8_t start, end, i;
+  StoneLCDBatchEntry *first;
+  boolean ok = true;
+
+  for (start = 0; start < this->batchCount; start = end) {
+    first = &this->batch[start];
+    // Find the end of the contiguous run that starts here
+    for (end = start + 1; end < this->batchCount; end++) {
+      if (this->batch[end].isRegister != first->isRegister) break;
+      if (this->batch[end].address != first->address + (end - start)) break;
+    }
+    if (first->isRegister) {
+      ok = ok && this->beginFrame(STONE_CMD_REGISTER_WRITE, 2 + (end - start)); // cmd (1) + address (1) + data size
+      ok = ok && this->frameByte((uint8_t)first->address);
+      for (i = start; i < end; i++) ok = ok && this->frameByte((uint8_t)this->batch[i].value);
+    } else {
+      ok = ok && this->beginFrame(STONE_CMD_VARIABLE_WRITE, 3 + ((end - start) << 1)); // cmd (1) + address (2) + data size
+      ok = ok && this->frameWord(first->address);
+      for (i = start; i < end; i++) ok = ok && this->frameWord(this->batch[i].value);
+    }
+    ok = ok && this->endFrame();
+    if (!ok || first->isRegister) continue;
+    for (i = start; i < end; i++) this->updateVariableCache(this->batch[i].address, this->batch[i].value);
+  }
+  this->batchCount = 0;
+  return ok;
+}
+
+// Register writes the user is waiting to see (page changes, sounds) jump
+// ahead of the rest in the TX queue
+boolean StoneLCD::writeUrgentRegister (uint8_t address, uint8_t *buffer, uint8_t len){
+  uint8_t priority = this->txPriority;
+  boolean ok;
+
+  this->txPriority = STONE_TX_HIGH;
+  ok = this->writeRegister(address, buffer, len);
+  this->txPriority = priority;
+  return ok;
+}
+
+#if STONE_VAR_CACHE_SIZE > 0
+// Binary search over the cache table, which is kept sorted by address
+StoneLCDCacheEntry *StoneLCD::findCacheEntry (uint16_t address){
+  int8_t lo = 0, hi = this->cacheCount - 1, mid;
+
+  while (lo <= hi) {
+    mid = (lo + hi) >> 1;
+    if (this->varCache[mid].address == address) return &this->varCache[mid];
+    if (this->varCache[mid].address < address) lo = mid + 1;
+    else hi = mid - 1;
+  }
+  return NULL;
+}
+#endif
+
+// Returns true (and counts a hit) if the address is shadowed and its value is
+// known. Shadowed addresses without a known value count as misses.
+boolean StoneLCD::getCachedVariable (uint16_t address, uint16_t *value){
+#if STONE_VAR_CACHE_SIZE > 0
+  StoneLCDCacheEntry *entry = this->findCacheEntry(address);
+
+  if (entry == NULL) return false;
+  if (!entry->valid) {
+    this->cacheMisses++;
+    return false;
+  }
+  this->cacheHits++;
+  *value = entry->value;
+  return true;
+#else
   return false;
+#endif
+}
+
+void StoneLCD::updateVariableCache (uint16_t address, uint16_t value){
+#if STONE_VAR_CACHE_SIZE > 0
+  StoneLCDCacheEntry *entry = this->findCacheEntry(address);
+
+  if (entry == NULL) return;
+  entry->value = value;
+  entry->valid = true;
+#endif
+}
+
+// Walks the variable writes of a script (see runScript) once it has been
+// sent. If it was, the cache takes their values; otherwise nobody knows how
+// much of it reached the display, so those variables are no longer known.
+void StoneLCD::syncScriptCache (const uint8_t *script, const uint16_t *params, uint8_t paramCount, boolean sent){
+#if STONE_VAR_CACHE_SIZE > 0
+  StoneLCDCacheEntry *entry;
+  uint8_t cmd, len, pos, slot, i, b;
+  uint16_t param = 0, address = 0, w = 0;
+
+  while ((cmd = pgm_read_byte(script)) != STONE_SCRIPT_END_CMD) {
+    len  = pgm_read_byte(script + 1);
+    pos  = pgm_read_byte(script + 2);
+    slot = pgm_read_byte(script + 3);
+    script += 4;
+    if (slot != STONE_SCRIPT_NO_PARAM) param = (slot < paramCount && params != NULL) ? params[slot] : 0;
+
+    for (i = 0; cmd == STONE_CMD_VARIABLE_WRITE && i < len; i++) {
+      b = pgm_read_byte(script + i);
+      if (slot != STONE_SCRIPT_NO_PARAM && i == pos)     b = (uint8_t)(param >> 8);
+      if (slot != STONE_SCRIPT_NO_PARAM && i == pos + 1) b = (uint8_t)(param & 0xff);
+      w = (w << 8) | b;
+      if (i == 1) address = w;
+      if (i < 2 || !(i & 1)) continue;
+      if (sent) {
+        this->updateVariableCache(address++, w);
+      } else {
+        entry = this->findCacheEntry(address++);
+        if (entry != NULL) entry->valid = false;
+      }
+    }
+    script += len;
+  }
+#endif
 }
 
 // ****************************************************
@@ -239,6 +1326,20 @@ void StoneLCD::setTimeoutMs(long timeout){
 	this->timeOutMs = timeout;
 }
 
+// Baud rate of the interface (8N1). With it, each read gets a deadline
+// based on its size and on how fast the display has been answering, with
+// the timeout as the limit for the latter. 0 = unknown, and every read just
+// gets the timeout.
+void StoneLCD::setBaudRate(uint32_t baud){
+  this->baudRate = baud;
+}
+
+// Times a read that got no reply is sent again (up to STONE_MAX_RETRIES),
+// doubling its deadline each time. 0 = fail on the first timeout.
+void StoneLCD::setRetries(uint8_t retries){
+  this->maxRetries = retries > STONE_MAX_RETRIES ? STONE_MAX_RETRIES : retries;
+}
+
 // ****************************************************
 // ** Getters
 // ****************************************************
@@ -246,55 +1347,163 @@ long StoneLCD::getTimeoutMs(){
 	return this->timeOutMs;
 }
 
+// Why the last read failed (STONE_ERR_xxx). Reads that return a value
+// (readRegisterByte(), readVariableWord(), ...) return 0 on failure, so
+// this is how to tell it from an actual 0. Blocking reads set it to
+// STONE_ERR_NONE when they succeed, and async reads when their status is
+// collected.
+uint8_t StoneLCD::getLastError(){
+  return this->lastError;
+}
+
+// Smoothed time the display takes to answer a read, not counting the time
+// on the wire. 0 until the first reply.
+unsigned long StoneLCD::getRoundTripUs(){
+  return this->srttUs;
+}
+
+boolean StoneLCD::isCRCEnabled(){
+  return this->useCRC;
+}
+
+// Frames dropped because their CRC didn't match
+uint16_t StoneLCD::getCRCErrorCount(){
+  return this->crcErrors;
+}
+
+// Copies the counters (and optionally clears them, so each snapshot covers
+// the time since the last one). Returns false if STONE_LCD_STATS is off.
+boolean StoneLCD::getStats(StoneLCDStats *dst, boolean reset){
+#if STONE_LCD_STATS
+  if (dst == NULL) return false;
+  *dst = this->stats;
+  if (reset) this->resetStats();
+  return true;
+#else
+  return false;
+#endif
+}
+
+void StoneLCD::resetStats(){
+#if STONE_LCD_STATS
+  memset(&this->stats, 0, sizeof(this->stats));
+#endif
+}
+
+// ****************************************************
+// ** "TX Queue" Methods
+// ****************************************************
+// Priority (STONE_TX_HIGH, STONE_TX_NORMAL or STONE_TX_LOW) of the frames
+// queued from here on. Frames of the same priority are sent in order; page
+// changes and sounds always go as STONE_TX_HIGH.
+void StoneLCD::setTxPriority(uint8_t priority){
+  this->txPriority = priority > STONE_TX_LOW ? STONE_TX_LOW : priority;
+}
+
+// Writes as much of the queue as the port takes without waiting. poll()
+// calls this, so it's only needed to push frames out sooner.
+void StoneLCD::drainTxQueue(){
+#if STONE_TX_QUEUE_SIZE > 0
+  if (this->interface == NULL) return;
+  while (this->sendQueuedFrame(false));
+#endif
+}
+
+// Sends every queued frame, waiting for the port as needed
+void StoneLCD::flushTxQueue(){
+#if STONE_TX_QUEUE_SIZE > 0
+  if (this->interface == NULL) return;
+  while (this->txFrameCount > 0) this->sendQueuedFrame(true);
+#endif
+}
+
+// Frames waiting to be sent
+uint8_t StoneLCD::getTxQueueLength(){
+#if STONE_TX_QUEUE_SIZE > 0
+  return this->txFrameCount;
+#else
+  return 0;
+#endif
+}
+
+// Bytes of frames that can be queued right now without waiting for the
+// port. Always 0 without a TX queue.
+uint16_t StoneLCD::getTxRoom(){
+#if STONE_TX_QUEUE_SIZE > 0
+  if (this->txFrameCount >= STONE_TX_QUEUE_FRAMES) return 0;
+  return STONE_TX_QUEUE_SIZE - this->txQueueUsed;
+#else
+  return 0;
+#endif
+}
+
+// ****************************************************
+// ** "Batch" Methods
+// ****************************************************
+// While a batch is open, single byte/word writes are queued instead of being
+// sent. flushBatch() sends them sorted by address, merging every contiguous
+// run into one frame. Note that this also means queued register writes reach
+// the display in address order rather than in call order.
+void StoneLCD::beginBatch(){
+  this->batching = true;
+}
+
+boolean StoneLCD::flushBatch(){
+  this->batching = false;
+  return this->sendBatch();
+}
+
+boolean StoneLCD::isBatching(){
+  return this->batching;
+}
+
 // ****************************************************
 // ** "Register" Methods
 // ****************************************************
-boolean StoneLCD::writeRegister(uint8_t regStartAddr, uint8_t *buffer, uint8_t buffLen){
-  // Header
-	tryOrReturnFalse (this->sendCmdFrameStart(STONE_CMD_REGISTER_WRITE, 2 + buffLen)); // cmd (1) + address (1) + data size (buffLen)
-  // Address
-  tryOrReturnFalse (this->sendByte(regStartAddr));
-  // Data
-  tryOrReturnFalse (this->sendBuffer((uint8_t *)buffer, buffLen));
-  // TO-DO: CRC
+// Writes longer than a frame can carry are split into back to back frames
+boolean StoneLCD::writeRegister(uint8_t regStartAddr, uint8_t *buffer, uint16_t buffLen){
+  uint8_t chunk;
+
+  // Queued writes go first so they are not overwritten by older values
+  if (this->batchCount > 0) tryOrReturnFalse (this->sendBatch());
+  while (buffLen > 0) {
+    chunk = buffLen > STONE_REG_WRITE_MAX_BYTES ? STONE_REG_WRITE_MAX_BYTES : buffLen;
+    // Header
+    tryOrReturnFalse (this->beginFrame(STONE_CMD_REGISTER_WRITE, 2 + chunk)); // cmd (1) + address (1) + data size (chunk)
+    // Address
+    tryOrReturnFalse (this->frameByte(regStartAddr));
+    // Data
+    tryOrReturnFalse (this->frameBuffer(buffer, chunk));
+    tryOrReturnFalse (this->endFrame());
+    regStartAddr += chunk;
+    buffer += chunk;
+    buffLen -= chunk;
+  }
   return true;
 }
 
 boolean StoneLCD::writeRegisterByte(uint8_t regStartAddr, uint8_t b){
   uint8_t buffer[1];
+  if (this->batching) return this->queueBatchWrite(1, regStartAddr, b);
+
   buffer[0] = b;
   return this->writeRegister(regStartAddr, buffer, 1);
 }
 
 boolean StoneLCD::writeRegisterWord(uint8_t regStartAddr, uint16_t w){
   uint8_t buffer[2];
+  if (this->batching) {
+    tryOrReturnFalse (this->queueBatchWrite(1, regStartAddr, w >> 8));
+    return this->queueBatchWrite(1, regStartAddr + 1, w & 0xff);
+  }
+
   buffer[0] = (uint8_t)(w >> 8);
   buffer[1] = (uint8_t)(w  & 0xff);
   return this->writeRegister(regStartAddr, buffer, 2);
 }
 
-boolean StoneLCD::readRegister(uint8_t regStartAddr, void *dest_buffer, uint8_t buffLen) {
-  byte r;
-
-  this->clearInputStream();
-  // Header
-  tryOrReturnFalse (this->sendCmdFrameStart(STONE_CMD_REGISTER_READ, 3)); // cmd (1) + address (1) + bytes to read (1 byte)
-  // Address
-  tryOrReturnFalse (this->sendByte(regStartAddr));
-  // Bytes to read
-  tryOrReturnFalse (this->sendByte(buffLen));
-
-  // Wait for data to be available and expect a valid response
-  tryOrReturnFalse (this->waitAndReadIOStream() == this->cmdFrameHSB);
-  tryOrReturnFalse (this->waitAndReadIOStream() == this->cmdFrameLSB);
-  tryOrReturnFalse (this->waitAndReadIOStream() == buffLen + 3); // cmd (1) + address (1) + requested bytes (1)
-  tryOrReturnFalse (this->waitAndReadIOStream() == STONE_CMD_REGISTER_READ);
-  tryOrReturnFalse (this->waitAndReadIOStream() == regStartAddr);
-  tryOrReturnFalse (this->waitAndReadIOStream() == buffLen);
-  for (r = 0; r < buffLen; r++) {
-    ((uint8_t *)dest_buffer)[r] = this->waitAndReadIOStream();
-  }
-  return true;
+boolean StoneLCD::readRegister(uint8_t regStartAddr, void *dest_buffer, uint16_t buffLen) {
+  return this->readBlock(STONE_CMD_REGISTER_READ, regStartAddr, (uint8_t *)dest_buffer, buffLen);
 }
 
 uint8_t StoneLCD::readRegisterByte(uint8_t regStartAddr) {
@@ -313,65 +1522,237 @@ uint16_t StoneLCD::readRegisterWord(uint8_t regStartAddr) {
 // ****************************************************
 // ** "Variable" Methods
 // ****************************************************
-boolean StoneLCD::writeVariable(uint16_t varStartAddr, uint16_t *buffer, uint8_t buffLen){
-  uint8_t buffSizeInBytes = buffLen<<1;
+// buffer holds the words in the host's byte order; they are sent big-endian,
+// as the display expects. Writes longer than a frame can carry are split into
+// back to back frames.
+boolean StoneLCD::writeVariable(uint16_t varStartAddr, uint16_t *buffer, uint16_t buffLen){
+  uint8_t r, chunk;
+
+  // Queued writes go first so they are not overwritten by older values
+  if (this->batchCount > 0) tryOrReturnFalse (this->sendBatch());
+  while (buffLen > 0) {
+    chunk = buffLen > STONE_VAR_WRITE_MAX_WORDS ? STONE_VAR_WRITE_MAX_WORDS : buffLen;
+    // Header
+    tryOrReturnFalse (this->beginFrame(STONE_CMD_VARIABLE_WRITE, 3 + (chunk<<1))); // cmd (1) + address (2) + data size (chunk*2)
+    // Address
+    tryOrReturnFalse (this->frameWord(varStartAddr));
+    // Data (word-based write)
+    for (r = 0; r < chunk; r++) tryOrReturnFalse (this->frameWord(buffer[r]));
+    tryOrReturnFalse (this->endFrame());
+    for (r = 0; r < chunk; r++) this->updateVariableCache(varStartAddr + r, buffer[r]);
+    varStartAddr += chunk;
+    buffer += chunk;
+    buffLen -= chunk;
+  }
+  return true;
+}
 
-  // Header
-  tryOrReturnFalse (this->sendCmdFrameStart(STONE_CMD_VARIABLE_WRITE, 3 + buffSizeInBytes)); // cmd (1) + address (2) + data size (buffLen*2)
-  // Address
-  tryOrReturnFalse (this->sendWord(varStartAddr));
-  // Data (word-based write)
-  tryOrReturnFalse (this->sendBuffer((uint8_t *)buffer, buffSizeInBytes));
-  // TO-DO: CRC
+// Writes a byte string (e.g. the contents of a text variable) as it is, two
+// bytes per variable. An odd length is padded with a 0 byte.
+boolean StoneLCD::writeVariableBytes(uint16_t varStartAddr, const uint8_t *buffer, uint16_t buffLen){
+  uint8_t r, chunk;
+  uint16_t words = (buffLen + 1) >> 1;
+
+  if (this->batchCount > 0) tryOrReturnFalse (this->sendBatch());
+  while (words > 0) {
+    chunk = words > STONE_VAR_WRITE_MAX_WORDS ? STONE_VAR_WRITE_MAX_WORDS : words;
+    tryOrReturnFalse (this->beginFrame(STONE_CMD_VARIABLE_WRITE, 3 + (chunk<<1))); // cmd (1) + address (2) + data size (chunk*2)
+    tryOrReturnFalse (this->frameWord(varStartAddr));
+    if (buffLen >= (uint16_t)(chunk<<1)) {
+      tryOrReturnFalse (this->frameBuffer(buffer, chunk<<1));
+    } else {
+      tryOrReturnFalse (this->frameBuffer(buffer, buffLen));
+      tryOrReturnFalse (this->frameByte(0));
+    }
+    tryOrReturnFalse (this->endFrame());
+    for (r = 0; r < chunk; r++) {
+      this->updateVariableCache(varStartAddr + r, wordFromBytes(buffer[r<<1], (r<<1) + 1 < buffLen ? buffer[(r<<1) + 1] : 0));
+    }
+    varStartAddr += chunk;
+    buffer += chunk<<1;
+    buffLen = buffLen > (uint16_t)(chunk<<1) ? buffLen - (chunk<<1) : 0;
+    words -= chunk;
+  }
   return true;
 }
 
 boolean StoneLCD::writeVariableWord(uint16_t varStartAddr, uint16_t w){
-  uint8_t buffer[2];
-  buffer[0] = (uint8_t)(w >> 8);
-  buffer[1] = (uint8_t)(w  & 0xff);
-  return this->writeVariable(varStartAddr, (uint16_t *)buffer, 1);
+  uint16_t cached;
+
+  // There's no need to send a value the display already has. A queued
+  // write of the address still has to be replaced, though.
+  if (this->batching && this->isBatchQueued(0, varStartAddr)) return this->queueBatchWrite(0, varStartAddr, w);
+  if (this->getCachedVariable(varStartAddr, &cached) && cached == w) return true;
+  if (this->batching) return this->queueBatchWrite(0, varStartAddr, w);
+  return this->writeVariable(varStartAddr, &w, 1);
 }
 
-boolean StoneLCD::readVariable(uint16_t varStartAddr, uint16_t *dest_buffer, uint8_t buffLen){
-  uint8_t r, h, l;
-  uint8_t buffSizeInBytes = buffLen<<1;
-  
-  this->clearInputStream();
-  // Header
-  tryOrReturnFalse (this->sendCmdFrameStart(STONE_CMD_VARIABLE_READ, 4)); // cmd (1) + address (2) + words to read (1 byte)
-  // Address
-  tryOrReturnFalse (this->sendWord(varStartAddr));
-  // Bytes to read
-  tryOrReturnFalse (this->sendByte(buffLen));
-  // Wait for data to be available and expect a valid response
-  tryOrReturnFalse (this->waitAndReadIOStream() == this->cmdFrameHSB);
-  tryOrReturnFalse (this->waitAndReadIOStream() == this->cmdFrameLSB);
-  tryOrReturnFalse (this->waitAndReadIOStream() == buffSizeInBytes + 4); // cmd (1) + address (2) + requested bytes (1)
-  tryOrReturnFalse (this->waitAndReadIOStream() == STONE_CMD_VARIABLE_READ);
-  tryOrReturnFalse (this->waitAndReadIOStream() == (varStartAddr >> 8));
-  tryOrReturnFalse (this->waitAndReadIOStream() == (varStartAddr & 0xff));
-  tryOrReturnFalse (this->waitAndReadIOStream() == buffLen);
-  for (r = 0; r < buffLen; r++) {
-    h = this->waitAndReadIOStream();
-    l = this->waitAndReadIOStream();
-    dest_buffer[r] = wordFromBytes(h, l);
-  }
-  return true;
+boolean StoneLCD::readVariable(uint16_t varStartAddr, uint16_t *dest_buffer, uint16_t buffLen){
+  return this->readBlock(STONE_CMD_VARIABLE_READ, varStartAddr, (uint8_t *)dest_buffer, buffLen);
 }
 
 uint16_t StoneLCD::readVariableWord(uint16_t varStartAddr) {
   uint16_t w;
-  boolean readOk = this->readVariable(varStartAddr, &w, 1);
+  boolean readOk;
+
+  if (this->getCachedVariable(varStartAddr, &w)) {
+    this->lastError = STONE_ERR_NONE;
+    return w;
+  }
+  readOk = this->readVariable(varStartAddr, &w, 1);
 
   return readOk ? w : 0;
 }
 
+// ****************************************************
+// ** "Async Read" Methods
+// ****************************************************
+// These send a read request and return right away with a handle (or -1 if
+// too many reads are in flight). The reply is picked up by poll() and written
+// to dest_buffer, which must stay valid until the read completes. Either pass
+// a callback, or check getReadStatus() until it stops returning
+// STONE_READ_PENDING.
+int8_t StoneLCD::requestRegisterRead(uint8_t regStartAddr, void *dest_buffer, uint8_t buffLen, StoneLCDReadCallback callback){
+  if (buffLen > STONE_REG_READ_MAX_BYTES) {
+    this->lastError = STONE_ERR_INVALID_ARG;
+    return -1;
+  }
+  return this->issueRead(STONE_CMD_REGISTER_READ, regStartAddr, buffLen, dest_buffer, callback);
+}
+
+int8_t StoneLCD::requestVariableRead(uint16_t varStartAddr, uint16_t *dest_buffer, uint8_t buffLen, StoneLCDReadCallback callback){
+  if (buffLen > STONE_VAR_READ_MAX_WORDS) {
+    this->lastError = STONE_ERR_INVALID_ARG;
+    return -1;
+  }
+  return this->issueRead(STONE_CMD_VARIABLE_READ, varStartAddr, buffLen, dest_buffer, callback);
+}
+
+// Returns STONE_READ_PENDING, STONE_READ_DONE or STONE_READ_FAILED. Once a
+// finished status has been returned the handle is released. Incoming data is
+// processed first, unless pollFirst is false (e.g. when checking several
+// handles right after a poll()).
+uint8_t StoneLCD::getReadStatus(int8_t handle, boolean pollFirst){
+  uint8_t status;
+
+  if (handle < 0 || handle >= STONE_MAX_PENDING_READS) return STONE_READ_FREE;
+  if (pollFirst) this->poll();
+  status = this->pendingReads[handle].status;
+  if (status == STONE_READ_DONE || status == STONE_READ_FAILED) {
+    this->pendingReads[handle].status = STONE_READ_FREE;
+    this->lastError = this->pendingReads[handle].error;
+  }
+  return status;
+}
+
+uint8_t StoneLCD::getPendingReadCount(){
+  uint8_t h, count = 0;
+  for (h = 0; h < STONE_MAX_PENDING_READS; h++) {
+    if (this->pendingReads[h].status == STONE_READ_PENDING) count++;
+  }
+  return count;
+}
+
+// ****************************************************
+// ** "Event Dispatch" Methods
+// ****************************************************
+// Once a handler is registered, poll() drains the event queue and calls the
+// handler of each event's address. Events with no handler go to the
+// onUnhandledEvent() handler, or are discarded if there's none.
+// Address ranges can't overlap.
+boolean StoneLCD::onEvent(uint16_t address, StoneLCDEventHandler handler){
+  return this->onEventRange(address, address, handler);
+}
+
+boolean StoneLCD::onEventRange(uint16_t firstAddress, uint16_t lastAddress, StoneLCDEventHandler handler){
+  uint8_t i, pos;
+
+  if (handler == NULL || lastAddress < firstAddress) return false;
+  if (this->handlerCount >= STONE_MAX_EVENT_HANDLERS) return false;
+  for (pos = 0; pos < this->handlerCount && this->handlers[pos].first < firstAddress; pos++);
+  if (pos > 0 && this->handlers[pos - 1].last >= firstAddress) return false;
+  if (pos < this->handlerCount && this->handlers[pos].first <= lastAddress) return false;
+
+  for (i = this->handlerCount; i > pos; i--) this->handlers[i] = this->handlers[i - 1];
+  this->handlers[pos].first = firstAddress;
+  this->handlers[pos].last = lastAddress;
+  this->handlers[pos].handler = handler;
+  this->handlerCount++;
+  return true;
+}
+
+void StoneLCD::onUnhandledEvent(StoneLCDEventHandler handler){
+  this->defaultHandler = handler;
+}
+
+uint16_t StoneLCD::getDroppedEventCount(){
+  return this->droppedEvents;
+}
+
+// ****************************************************
+// ** "Variable Cache" Methods
+// ****************************************************
+// Registers a variable to be shadowed. Writes of an unchanged value are then
+// skipped, and readVariableWord() is served from the cache once the value is
+// known (written, read, or reported by the display through an event).
+boolean StoneLCD::cacheVariable(uint16_t varAddr){
+#if STONE_VAR_CACHE_SIZE > 0
+  uint8_t i;
+
+  if (this->findCacheEntry(varAddr) != NULL) return true;
+  if (this->cacheCount >= STONE_VAR_CACHE_SIZE) return false;
+  for (i = this->cacheCount; i > 0 && this->varCache[i - 1].address > varAddr; i--) {
+    this->varCache[i] = this->varCache[i - 1];
+  }
+  this->varCache[i].address = varAddr;
+  this->varCache[i].value = 0;
+  this->varCache[i].valid = false;
+  this->cacheCount++;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void StoneLCD::invalidateVariableCache(){
+#if STONE_VAR_CACHE_SIZE > 0
+  uint8_t i;
+  for (i = 0; i < this->cacheCount; i++) this->varCache[i].valid = false;
+#endif
+}
+
+uint32_t StoneLCD::getCacheHits(){
+#if STONE_VAR_CACHE_SIZE > 0
+  return this->cacheHits;
+#else
+  return 0;
+#endif
+}
+
+uint32_t StoneLCD::getCacheMisses(){
+#if STONE_VAR_CACHE_SIZE > 0
+  return this->cacheMisses;
+#else
+  return 0;
+#endif
+}
+
+void StoneLCD::resetCacheStats(){
+#if STONE_VAR_CACHE_SIZE > 0
+  this->cacheHits = 0;
+  this->cacheMisses = 0;
+#endif
+}
+
 // ****************************************************
 // ** "Page" Methods
 // ****************************************************
 boolean StoneLCD::setCurrentPage(uint16_t picId) {
-  return writeRegisterWord(STONE_REG_PIC_ID, picId);
+  uint8_t buffer[2];
+
+  buffer[0] = (uint8_t)(picId >> 8);
+  buffer[1] = (uint8_t)(picId & 0xff);
+  return this->writeUrgentRegister(STONE_REG_PIC_ID, buffer, 2);
 }
 
 uint16_t StoneLCD::getCurrentPage() {
@@ -388,7 +1769,7 @@ boolean StoneLCD::playSound(uint16_t soundId, uint8_t volume) {
   dataBuffer[2] = soundId & 0xff; // ID
   dataBuffer[3] = 0x54;           // Apply Volume
   dataBuffer[4] = volume;         // Volume
-  return writeRegister(STONE_REG_MUSIC_SET, dataBuffer, 5);
+  return this->writeUrgentRegister(STONE_REG_MUSIC_SET, dataBuffer, 5);
 }
 
 boolean StoneLCD::stopSound(uint16_t soundId) {
@@ -396,12 +1777,110 @@ boolean StoneLCD::stopSound(uint16_t soundId) {
   dataBuffer[0] = 0x5C;           // Stop
   dataBuffer[1] = soundId >> 8;   // ID
   dataBuffer[2] = soundId & 0xff; // ID
-  return writeRegister(STONE_REG_MUSIC_SET, dataBuffer, 3);
+  return this->writeUrgentRegister(STONE_REG_MUSIC_SET, dataBuffer, 3);
+}
+
+// Sounds the buzzer for time x 10ms
+boolean StoneLCD::beep(uint8_t time) {
+  return this->writeUrgentRegister(STONE_REG_BZ_TIME, &time, 1);
 }
 
 uint8_t StoneLCD::getSoundPlaybackStatus() {
   return readRegisterByte(STONE_REG_VOL_STATUS);
 }
+// ****************************************************
+// ** "Curve Buffer" Methods
+// ****************************************************
+// samples holds groups of one word per channel in channelMask, lowest channel
+// first, so sampleCount must be a multiple of the number of channels set.
+boolean StoneLCD::writeCurveBuffer(uint8_t channelMask, uint16_t *samples, uint8_t sampleCount) {
+  uint8_t i;
+
+  if (channelMask == 0 || samples == NULL || sampleCount > STONE_CURVE_MAX_WORDS) return false;
+  if (this->batchCount > 0) tryOrReturnFalse (this->sendBatch());
+  // Header
+  tryOrReturnFalse (this->beginFrame(STONE_CMD_CURVE_BUFFER_WRITE, 2 + (sampleCount<<1))); // cmd (1) + channel mask (1) + data size
+  // Channels
+  tryOrReturnFalse (this->frameByte(channelMask));
+  // Data
+  for (i = 0; i < sampleCount; i++) tryOrReturnFalse (this->frameWord(samples[i]));
+  return this->endFrame();
+}
+
+boolean StoneLCD::clearCurveBuffer(uint8_t channel) {
+  if (channel >= STONE_CURVE_CHANNELS) return false;
+  return this->writeRegisterByte(STONE_REG_TRENDLINE_CLEAR, 0x56 + channel);
+}
+
+boolean StoneLCD::clearAllCurveBuffers() {
+  return this->writeRegisterByte(STONE_REG_TRENDLINE_CLEAR, 0x55);
+}
+
+// ****************************************************
+// ** "Raw Frame" Methods
+// ****************************************************
+// For frames the other methods don't build (e.g. by helper classes). len is
+// the length the frame header announces, without the CRC: cmd (1) plus
+// everything added. Batched writes still queued are sent first, so frames
+// go out in the order they were requested. Nothing is sent if the frame
+// isn't finished.
+boolean StoneLCD::startFrame(uint8_t cmd, uint8_t len) {
+  if (this->batchCount > 0) tryOrReturnFalse (this->sendBatch());
+  return this->beginFrame(cmd, len);
+}
+
+boolean StoneLCD::addFrameByte(uint8_t b) {
+  return this->frameByte(b);
+}
+
+boolean StoneLCD::addFrameWord(uint16_t w) {
+  return this->frameWord(w);
+}
+
+boolean StoneLCD::finishFrame() {
+  return this->endFrame();
+}
+
+// ****************************************************
+// ** "Frame Script" Methods
+// ****************************************************
+// Sends a script declared with the StoneLCDScript.h macros, read straight
+// from flash (PROGMEM). Parameter slots take their value from params (0 if
+// paramCount is too short). Frames are packed back to back, so a script
+// usually takes a single write() call.
+boolean StoneLCD::runScript(const uint8_t *script, const uint16_t *params, uint8_t paramCount) {
+  const uint8_t *start = script;
+  uint8_t cmd, len, pos, slot, i, b;
+  uint16_t param = 0;
+  boolean ok = true;
+
+  if (script == NULL) return false;
+  if (this->batchCount > 0) tryOrReturnFalse (this->sendBatch());
+  this->txHold = true;
+  while (ok && (cmd = pgm_read_byte(script)) != STONE_SCRIPT_END_CMD) {
+    len  = pgm_read_byte(script + 1);
+    pos  = pgm_read_byte(script + 2);
+    slot = pgm_read_byte(script + 3);
+    script += 4;
+    if (slot != STONE_SCRIPT_NO_PARAM) param = (slot < paramCount && params != NULL) ? params[slot] : 0;
+
+    ok = this->beginFrame(cmd, 1 + len);                // cmd (1) + payload
+    for (i = 0; ok && i < len; i++) {
+      b = pgm_read_byte(script + i);
+      if (slot != STONE_SCRIPT_NO_PARAM && i == pos)     b = (uint8_t)(param >> 8);
+      if (slot != STONE_SCRIPT_NO_PARAM && i == pos + 1) b = (uint8_t)(param & 0xff);
+      ok = this->frameByte(b);
+    }
+    ok = ok && this->endFrame();
+    script += len;
+  }
+  this->txHold = false;
+  ok = this->flushTxBuffer() && ok;
+  // Keep shadowed variables in sync
+  this->syncScriptCache(start, params, paramCount, ok);
+  return ok;
+}
+
 // ****************************************************
 // ** "RTC" Methods
 // ****************************************************
@@ -424,37 +1903,70 @@ boolean StoneLCD::setRTC(StoneLCDDateTime *src){
   return this->writeRegister(STONE_REG_RTC_COM_ADJ, dateBuffer, STONE_DATETIME_BDC_BUFFER_SIZE+1);
 }
 
+// ****************************************************
+// ** "Status" Methods
+// ****************************************************
+// Reads registers 0x00 - 0x0F with a single request and decodes them
+boolean StoneLCD::getStatus(StoneLCDStatus *dst) {
+  uint8_t regs[STONE_STATUS_REG_BLOCK_SIZE];
+
+  if (dst == NULL) return false;
+  tryOrReturnFalse (this->readRegister(STONE_REG_VERSION, regs, STONE_STATUS_REG_BLOCK_SIZE));
+  decodeStatus(regs, dst);
+  return true;
+}
+
 // ****************************************************
 // ** Public I/O Methods
 // ****************************************************
+// Routes every complete frame received so far: replies go to their pending
+// reads and everything else is queued as an event. If event handlers are
+// registered, the queue is dispatched as frames come in, so bursts don't
+// overflow it. Returns the number of events handled.
+uint8_t StoneLCD::poll(){
+  uint8_t handled = 0;
+  boolean dispatch = (this->handlerCount > 0 || this->defaultHandler != NULL);
+
+  this->drainTxQueue();
+  while (this->receiveFrame()) {
+    if (!this->matchPendingRead()) this->queueEvent();
+    if (dispatch) handled += this->dispatchEvents();
+  }
+  this->checkReadTimeouts();
+  return handled;
+}
+
 boolean StoneLCD::checkForIOEvent(StoneLCDEvent *dst, uint16_t *dataDest, uint8_t maxLen){
-  int i;
-  uint8_t len = 0;
-  uint8_t h, l;
+  StoneLCDQueuedFrame *evt;
   if (dst == NULL || dataDest == NULL || this->interface == NULL) return false;
 
   dst->cmd = 0;
   dst->dataLen = 0;
   dst->address = 0;
-if (this->interface->available()){
-    // Try to identify the beginning of a command frame and then start parsing the rest
-    if (this->interface->read() == this->cmdFrameHSB){
-      tryOrReturnFalse (this->waitAndReadIOStream() == this->cmdFrameLSB);
-      len = this->waitAndReadIOStream();
-      dst->cmd = this->waitAndReadIOStream();
-      h = this->waitAndReadIOStream();
-      l = this->waitAndReadIOStream();
-      dst->address = wordFromBytes(h, l);
-      dst->dataLen = this->waitAndReadIOStream();
-      
-      for (i = 0; i < dst->dataLen; i++) {
-        h = this->waitAndReadIOStream();
-        l = this->waitAndReadIOStream();
-        if (i < maxLen) dataDest[i] = wordFromBytes(h, l);
-      }
-      // Just as a sanity check, len should have been 4 + len*2
-      return ( len == (4 + (dst->dataLen<<1)) );
-    }
+  // Frames are assembled across calls; nothing is reported until one is complete
+  this->poll();
+  if (this->eventCount == 0) return false;
+
+  evt = &this->eventQueue[this->eventHead];
+  this->eventHead = (this->eventHead + 1) % STONE_EVENT_QUEUE_SIZE;
+  this->eventCount--;
+  return this->decodeEvent(evt, dst, dataDest, maxLen);
+}
+
+// Takes the oldest queued event without copying its data: dst points to the
+// queue entry, which stays untouched until the next call that reads from the
+// display. Frames longer than STONE_EVENT_BUFFER_SIZE come with
+// dst->truncated set. Malformed frames are skipped.
+boolean StoneLCD::checkForFrame(StoneLCDFrame *dst){
+  StoneLCDQueuedFrame *evt;
+  if (dst == NULL || this->interface == NULL) return false;
+
+  this->poll();
+  while (this->eventCount > 0) {
+    evt = &this->eventQueue[this->eventHead];
+    this->eventHead = (this->eventHead + 1) % STONE_EVENT_QUEUE_SIZE;
+    this->eventCount--;
+    if (decodeFrame(evt->data, evt->frameLen, STONE_EVENT_STORED_BYTES, dst)) return true;
   }
   return false;
 }
@@ -18,7 +18,149 @@
  *##                               D E F I N E S                            ##
  *##                                                                        ##
  *############################################################################*/
+// Unix time of 2000-01-01 00:00:00, the earliest date the RTC can hold
+#define STONE_EPOCH_2000                946684800UL
+
 #define STONE_DATETIME_BDC_BUFFER_SIZE  7
+#define STONE_STATUS_REG_BLOCK_SIZE     16 // Registers 0x00 - 0x0F
+
+// --- Library configuration -----------------------------------
+// Incoming frame bytes (cmd + payload) kept by the RX parser. Longer frames
+// are still consumed, but everything past this size is discarded.
+#ifndef STONE_RX_BUFFER_SIZE
+#define STONE_RX_BUFFER_SIZE            32
+#endif
+
+// Outgoing frames are assembled here and sent with a single write(). Frames
+// that don't fit are sent in as few writes as this size allows.
+#ifndef STONE_TX_BUFFER_SIZE
+#define STONE_TX_BUFFER_SIZE            32
+#endif
+
+// Bytes of outgoing frames that can wait to be sent. With a queue, frames
+// are written only as far as the port's availableForWrite() allows, and the
+// rest is sent by poll(), so writes never wait for the port. Frames that
+// don't fit in the queue at all are sent right away. 0 = no queue (every
+// frame is written at once); keep it at 0 with ports that don't implement
+// availableForWrite(), since Print's default reports no room at all.
+#ifndef STONE_TX_QUEUE_SIZE
+#define STONE_TX_QUEUE_SIZE             0
+#endif
+
+// Frames the TX queue can hold
+#ifndef STONE_TX_QUEUE_FRAMES
+#define STONE_TX_QUEUE_FRAMES           8
+#endif
+
+#if STONE_TX_QUEUE_SIZE > 255
+#error "STONE_TX_QUEUE_SIZE can't be over 255"
+#endif
+
+// Number of word/byte writes a batch can hold. A full batch is sent and
+// then keeps collecting writes.
+#ifndef STONE_BATCH_SIZE
+#define STONE_BATCH_SIZE                12
+#endif
+
+// Number of variables (VPs) that can be shadowed by the variable cache. Each
+// entry takes 5 bytes of RAM. Set to 0 to leave the cache out completely.
+#ifndef STONE_VAR_CACHE_SIZE
+#define STONE_VAR_CACHE_SIZE            0
+#endif
+
+// Reads that can be waiting for a reply at the same time
+#ifndef STONE_MAX_PENDING_READS
+#define STONE_MAX_PENDING_READS         4
+#endif
+
+// Frames received from the display that are not replies to a read are queued
+// here until the application takes them. Each slot keeps up to
+// STONE_EVENT_BUFFER_SIZE bytes of the frame (cmd + payload).
+#ifndef STONE_EVENT_QUEUE_SIZE
+#define STONE_EVENT_QUEUE_SIZE          4
+#endif
+
+#ifndef STONE_EVENT_BUFFER_SIZE
+#define STONE_EVENT_BUFFER_SIZE         12
+#endif
+#define STONE_EVENT_MAX_WORDS           ((STONE_EVENT_BUFFER_SIZE - 4) >> 1)
+
+// Addresses or address ranges that can have an event handler
+#ifndef STONE_MAX_EVENT_HANDLERS
+#define STONE_MAX_EVENT_HANDLERS        8
+#endif
+
+// Set to 1 to keep traffic, error and timing counters (see getStats()).
+// When 0 the counters are not compiled in at all.
+#ifndef STONE_LCD_STATS
+#define STONE_LCD_STATS                 0
+#endif
+
+// Read deadlines (see setBaudRate). Once the baud rate is known each read
+// gets the time its frames take on the wire, plus the display's turnaround
+// as estimated from previous replies (never below STONE_MIN_TIMEOUT_MS nor
+// above the configured timeout).
+#define STONE_MIN_TIMEOUT_MS            5
+#define STONE_TIMEOUT_MARGIN_MS         2
+#define STONE_MAX_RETRIES               3   // Limit for setRetries()
+
+// Read round-trip histogram: bucket 0 counts replies under 256us, and each
+// following bucket doubles the limit. The last one takes everything slower.
+#define STONE_STATS_RTT_BUCKETS         12
+#define STONE_STATS_CMD_COUNT           5  // 0x80 - 0x84
+
+// Largest writes that fit in a single frame (the length byte counts from the
+// cmd byte to the end, CRC included)
+#define STONE_REG_WRITE_MAX_BYTES       (255 - 2 - 2)          // cmd (1) + address (1) + CRC (2)
+#define STONE_VAR_WRITE_MAX_WORDS       ((255 - 3 - 2) >> 1)   // cmd (1) + address (2) + CRC (2)
+
+// Largest reads that fit in a single reply frame
+#define STONE_REG_READ_MAX_BYTES        (STONE_RX_BUFFER_SIZE - 3)        // cmd (1) + address (1) + length (1)
+#define STONE_VAR_READ_MAX_WORDS        ((STONE_RX_BUFFER_SIZE - 4) >> 1) // cmd (1) + address (2) + length (1)
+
+// Curve buffer frames carry a channel mask byte and then the sample words
+#define STONE_CURVE_MAX_WORDS           120
+#define STONE_CURVE_CHANNELS            8
+
+// --- Async read status ---------------------------------------
+#define STONE_READ_FREE                 0
+#define STONE_READ_PENDING              1
+#define STONE_READ_DONE                 2
+#define STONE_READ_FAILED               3
+
+// --- TX queue priorities (see setTxPriority) ---------------
+#define STONE_TX_HIGH                   0  // Page changes and sounds
+#define STONE_TX_NORMAL                 1
+#define STONE_TX_LOW                    2  // Bulk refreshes
+
+// --- Frame scripts (see StoneLCDScript.h) ------------------
+#define STONE_SCRIPT_END_CMD            0x00
+#define STONE_SCRIPT_NO_PARAM           0xFF
+
+// --- Error codes (see getLastError) --------------------------
+#define STONE_ERR_NONE                  0
+#define STONE_ERR_TIMEOUT               1  // No reply, after every retry
+#define STONE_ERR_BAD_REPLY             2  // Reply length didn't match the request
+#define STONE_ERR_CRC                   3  // Reply dropped because of its CRC
+#define STONE_ERR_NO_SLOT               4  // STONE_MAX_PENDING_READS reads in flight
+#define STONE_ERR_SEND                  5  // Request couldn't be sent (no interface)
+#define STONE_ERR_INVALID_ARG           6
+
+// --- Status snapshot fields (see compareStatus) -------------
+#define STONE_STATUS_VERSION            0x01
+#define STONE_STATUS_BACKLIGHT          0x02
+#define STONE_STATUS_BUZZER             0x04
+#define STONE_STATUS_PAGE               0x08
+#define STONE_STATUS_TOUCH              0x10
+#define STONE_STATUS_TOUCH_ENABLE       0x20
+#define STONE_STATUS_RUNTIME            0x40
+
+// --- RX Parser states ----------------------------------------
+#define STONE_RX_WAIT_HEADER_HI         0
+#define STONE_RX_WAIT_HEADER_LO         1
+#define STONE_RX_WAIT_LENGTH            2
+#define STONE_RX_WAIT_CMD               3
+#define STONE_RX_WAIT_BODY              4
 
 // --- STONE CMD Constants -------------------------------------
 #define STONE_CMD_REGISTER_WRITE        0x80
@@ -80,8 +222,8 @@
 #define STONE_REG_PLAY_POSITION_X       0x62 // 2 bytes
 #define STONE_REG_PLAY_POSITION_Y       0x64 // 2 bytes
 #define STONE_REG_PLAY_AVI_NUM          0x66 // 2 bytes. Only usef for single play.
-#define STONE_REG_VOL_ADJ_EN            0x68 // 0x5A = Adjust volume
-#define STONE_REG_VOL                   0x69 // Range: 0x00 - 0x3F (Default)
+#define STONE_REG_AVI_VOL_ADJ_EN        0x68 // 0x5A = Adjust volume
+#define STONE_REG_AVI_VOL               0x69 // Range: 0x00 - 0x3F (Default)
 #define STONE_REG_PLAY_CONTROL          0x6A // 0x5A = Play / Pause
 #define STONE_REG_PLAY_STOP             0x6B // 0x5A = Stop
 #define STONE_REG_PLAY_NEXT             0x6C // 0x5A = Play next. Ends with single play.
@@ -102,6 +244,123 @@ typedef struct {
   uint8_t dataLen;
 } StoneLCDEvent;
 
+typedef struct {
+  uint8_t  isRegister; // 1 = register byte, 0 = variable word
+  uint16_t address;
+  uint16_t value;
+} StoneLCDBatchEntry;
+
+typedef struct {
+  uint16_t address;
+  uint16_t value;
+  uint8_t  valid;
+} StoneLCDCacheEntry;
+
+typedef struct {
+  uint32_t txBytes;
+  uint32_t rxBytes;
+  uint16_t txFrames[STONE_STATS_CMD_COUNT];  // Indexed by cmd - 0x80
+  uint16_t rxFrames[STONE_STATS_CMD_COUNT];
+  uint16_t timeouts;
+  uint16_t resyncs;       // Frame headers that turned out to be invalid
+  uint16_t garbageBytes;  // Bytes skipped while looking for a frame
+  uint16_t crcErrors;
+  uint16_t rttHistogram[STONE_STATS_RTT_BUCKETS];
+} StoneLCDStats;
+
+// Called when an async read completes (success = true) or times out.
+typedef void (*StoneLCDReadCallback)(int8_t handle, boolean success);
+
+typedef struct {
+  uint8_t  status;
+  uint8_t  seq;      // Issue order, to match replies to the oldest request first
+  uint8_t  cmd;
+  uint16_t address;
+  uint8_t  len;      // Bytes for register reads, words for variable reads
+  void    *dest;
+  uint8_t  attempts; // Retries sent so far
+  uint8_t  error;    // STONE_ERR_xxx once failed
+  unsigned long sentAt;
+  unsigned long sentAtUs;
+  unsigned long timeoutMs;
+#if STONE_TX_QUEUE_SIZE > 0
+  boolean  queued;   // The request is still in the TX queue
+#endif
+  StoneLCDReadCallback callback;
+} StoneLCDPendingRead;
+
+// Frame waiting in the TX queue
+typedef struct {
+  uint8_t  offset;   // In the queue buffer
+  uint8_t  len;
+  uint8_t  priority;
+  int8_t   handle;   // Read slot waiting for this request, or -1
+} StoneLCDTxFrame;
+
+// Request that was sent again after a timeout. If the original reply shows
+// up late, the one to the retry is dropped when it arrives.
+typedef struct {
+  uint8_t  cmd;      // 0 = unused
+  uint8_t  len;
+  uint16_t address;
+  unsigned long until;
+} StoneLCDStrayReply;
+
+// Receives a decoded event. data holds evt->dataLen words.
+typedef void (*StoneLCDEventHandler)(StoneLCDEvent *evt, uint16_t *data);
+
+typedef struct {
+  uint16_t first;
+  uint16_t last;
+  StoneLCDEventHandler handler;
+} StoneLCDHandlerEntry;
+
+typedef struct {
+  uint8_t frameLen;  // Length announced by the frame
+  uint8_t data[STONE_EVENT_BUFFER_SIZE];
+} StoneLCDQueuedFrame;
+
+// View of a received frame (any of 0x80 - 0x84). data points into the
+// library's buffers, so it's only valid until the next call that reads from
+// the display (poll(), reads, checkForIOEvent()...).
+typedef struct {
+  uint8_t  cmd;
+  uint16_t address;        // Register, variable, or channel mask (0x84)
+  uint8_t  count;          // Bytes (0x80, 0x81) or words (0x82 - 0x84) in the frame
+  const uint8_t *data;     // Payload, as received (words are big-endian)
+  uint8_t  len;            // Payload bytes in data
+  boolean  truncated;      // The frame had more than len bytes of payload
+
+  uint8_t  byteAt(uint8_t i) const { return i < len ? data[i] : 0; }
+  uint16_t wordAt(uint8_t i) const { return (uint16_t)(i << 1) + 1 < len ? (uint16_t)((data[i << 1] << 8) | data[(i << 1) + 1]) : 0; }
+  uint8_t  words() const { return len >> 1; }
+} StoneLCDFrame;
+
+// Decoded copy of registers 0x00 - 0x0F
+typedef struct {
+  uint8_t  version;
+  uint8_t  backlight;      // LED_NOW
+  uint8_t  buzzerTime;     // BZ_TIME, in 10ms units
+  uint16_t pageId;
+  uint8_t  touchFlag;      // 0x5A when there's new touch data
+  uint8_t  touchStatus;    // 0x01 = First press, 0x03 = Still pressed, 0x02 released
+  uint16_t touchX, touchY;
+  uint8_t  touchEnabled;   // TPC_ENABLE
+  uint16_t runHours;       // Runtime counter, HHHH:MM:SS
+  uint8_t  runMinutes;
+  uint8_t  runSeconds;
+} StoneLCDStatus;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                           F U N C T I O N S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+uint16_t CRC16Update (uint16_t crc, uint8_t b);
+void     decodeStatus (const uint8_t *regs, StoneLCDStatus *dst);
+boolean  decodeFrame (const uint8_t *frame, uint8_t frameLen, uint8_t stored, StoneLCDFrame *dst);
+uint8_t  compareStatus (const StoneLCDStatus *a, const StoneLCDStatus *b);
+
 /*############################################################################
  *##                                                                        ##
  *##                     S t o n e L C D D a t e T i m e                    ##
@@ -140,6 +399,9 @@ public:
 
   uint8_t getBCD(uint8_t *destBuffer);
   void setFromBCDBuffer(uint8_t *srcBuffer);
+
+  uint32_t getEpoch();
+  void setFromEpoch(uint32_t epoch);
 };
 
 /*############################################################################
@@ -147,59 +409,225 @@ public:
  *##                            S t o n e L C D                             ##
  *##                                                                        ##
  *############################################################################*/
-// Pending: CRC
 class StoneLCD {
 private:
   uint8_t cmdFrameLSB, cmdFrameHSB;
+  boolean useCRC;
   Stream *interface;
   long timeOutMs = 200;
+  uint32_t baudRate;
+  uint8_t maxRetries;
+  uint8_t lastError;
+  boolean hasRtt;
+  long srttUs, rttVarUs;     // Smoothed display turnaround and its variation
+
+  // Incremental RX parser state
+  uint8_t rxState;
+  uint8_t rxLen;      // Frame length as announced by the frame header
+  uint8_t rxCount;    // Body bytes (cmd + payload) received so far
+  uint16_t rxCRC;
+  uint16_t crcErrors;
+  uint8_t rxBuffer[STONE_RX_BUFFER_SIZE];
 
   uint8_t  ioBytesAvailable();
   uint8_t  readIOStream();
-  uint8_t  waitAndReadIOStream();
 
-  boolean sendCmdFrameStart (uint8_t cmd, uint8_t len);
-  boolean sendByte (uint8_t b);
-  boolean sendWord (uint16_t w);
-  boolean sendBuffer (uint8_t *b, byte bufflen);
-  
+  void    resetParser();
+  void    resyncParser(uint8_t *pending, uint8_t pendingLen);
+  boolean parseIOByte(uint8_t b);
+  boolean receiveFrame();
+
+  // Outgoing frame builder
+  uint8_t txCount;
+  uint16_t txCRC;
+  uint8_t txBuffer[STONE_TX_BUFFER_SIZE];
+
+  uint8_t txPriority;
+  boolean txHold;         // Keep frames in txBuffer until it's full
+#if STONE_TX_QUEUE_SIZE > 0
+  // TX queue. Frames are kept in the order they were built.
+  boolean txQueued;       // The frame being built goes to the queue
+  int8_t  txHandle;       // Read slot the frame being built is for
+  uint8_t txFrameStart;
+  uint8_t txQueueUsed, txFrameCount;
+  int8_t  txCurrent;      // Frame being sent, or -1
+  uint8_t txSent;         // ... and its bytes already written
+  StoneLCDTxFrame txFrames[STONE_TX_QUEUE_FRAMES];
+  uint8_t txQueue[STONE_TX_QUEUE_SIZE];
+
+  boolean sendQueuedFrame (boolean block);
+  void    removeQueuedFrame (uint8_t index);
+  void    dropSupersededFrames ();
+#endif
+
+  boolean flushTxBuffer ();
+  boolean beginFrame (uint8_t cmd, uint8_t len);
+  boolean frameByte (uint8_t b);
+  boolean frameWord (uint16_t w);
+  boolean frameBuffer (const uint8_t *b, uint8_t bufflen);
+  boolean endFrame ();
+
+  // Write batching
+  boolean batching;
+  uint8_t batchCount;
+  StoneLCDBatchEntry batch[STONE_BATCH_SIZE];
+
+  boolean queueBatchWrite (uint8_t isRegister, uint16_t address, uint16_t value);
+  boolean isBatchQueued (uint8_t isRegister, uint16_t address);
+  boolean writeUrgentRegister (uint8_t address, uint8_t *buffer, uint8_t len);
+  boolean sendBatch ();
+
+  // Variable cache
+#if STONE_VAR_CACHE_SIZE > 0
+  uint8_t  cacheCount;
+  uint32_t cacheHits, cacheMisses;
+  StoneLCDCacheEntry varCache[STONE_VAR_CACHE_SIZE];
+
+  StoneLCDCacheEntry *findCacheEntry (uint16_t address);
+#endif
+  boolean getCachedVariable (uint16_t address, uint16_t *value);
+  void    updateVariableCache (uint16_t address, uint16_t value);
+  void    syncScriptCache (const uint8_t *script, const uint16_t *params, uint8_t paramCount, boolean sent);
+
+  // Async reads and received events
+  uint8_t readSeq;
+  StoneLCDPendingRead pendingReads[STONE_MAX_PENDING_READS];
+  StoneLCDStrayReply strays[STONE_MAX_PENDING_READS];
+  uint8_t eventHead, eventCount;
+  StoneLCDQueuedFrame eventQueue[STONE_EVENT_QUEUE_SIZE];
+  uint16_t droppedEvents;
+
+  // Event dispatch
+  boolean dispatching;
+  uint8_t handlerCount;
+  StoneLCDHandlerEntry handlers[STONE_MAX_EVENT_HANDLERS];
+  StoneLCDEventHandler defaultHandler;
+
+#if STONE_LCD_STATS
+  StoneLCDStats stats;
+#endif
+
+  unsigned long wireTimeUs (uint16_t bytes);
+  uint16_t readFrameBytes (uint8_t cmd, uint8_t len, boolean reply);
+  unsigned long readTimeoutMs (int8_t handle);
+  void    updateRoundTrip (StoneLCDPendingRead *pr);
+  boolean sendReadRequest (uint8_t cmd, uint16_t address, uint8_t len);
+  boolean retryRead (int8_t handle);
+  boolean dropStrayReply (uint8_t cmd, uint16_t address, uint8_t len);
+  int8_t  issueRead (uint8_t cmd, uint16_t address, uint8_t len, void *dest, StoneLCDReadCallback callback);
+  void    completeRead (int8_t handle, uint8_t status, uint8_t error = STONE_ERR_NONE);
+  void    failOldestRead (uint8_t cmd);
+  boolean matchPendingRead ();
+  void    queueEvent ();
+  void    checkReadTimeouts ();
+  boolean waitForRead (int8_t handle);
+  boolean readBlock (uint8_t cmd, uint16_t address, uint8_t *dest, uint16_t len);
+#if STONE_LCD_STATS
+  void    recordRoundTrip (unsigned long us);
+#endif
+  boolean decodeEvent (StoneLCDQueuedFrame *evt, StoneLCDEvent *dst, uint16_t *dataDest, uint8_t maxLen);
+  StoneLCDEventHandler findEventHandler (uint16_t address);
+  uint8_t dispatchEvents ();
+
 public:
-  StoneLCD (Stream *ioPort, uint8_t cmdHi = 0xA5, uint8_t cmdLo = 0x5A);
+  StoneLCD (Stream *ioPort, uint8_t cmdHi = 0xA5, uint8_t cmdLo = 0x5A, boolean crcMode = false);
 
   void setTimeoutMs(long timeout);
   long getTimeoutMs();
+  void setBaudRate(uint32_t baud);
+  void setRetries(uint8_t retries);
+  uint8_t getLastError();
+  unsigned long getRoundTripUs();
+  boolean isCRCEnabled();
+  uint16_t getCRCErrorCount();
+
+  // Statistics (STONE_LCD_STATS) *
+  boolean getStats(StoneLCDStats *dst, boolean reset = false);
+  void    resetStats();
+
+  // TX queue (STONE_TX_QUEUE_SIZE)
+  void    setTxPriority(uint8_t priority);
+  void    drainTxQueue();
+  void    flushTxQueue();
+  uint8_t getTxQueueLength();
+  uint16_t getTxRoom();
+
+  // Batch functions *************
+  void    beginBatch();
+  boolean flushBatch();
+  boolean isBatching();
 
   // Register functions **********
-  boolean writeRegister(uint8_t regStartAddr, uint8_t *buffer, uint8_t buffLen);
+  boolean writeRegister(uint8_t regStartAddr, uint8_t *buffer, uint16_t buffLen);
   boolean writeRegisterByte(uint8_t regStartAddr, uint8_t b);
   boolean writeRegisterWord(uint8_t regStartAddr, uint16_t w);
 
-  boolean readRegister(uint8_t regStartAddr, void *dest_buffer, uint8_t buffLen);
+  boolean readRegister(uint8_t regStartAddr, void *dest_buffer, uint16_t buffLen);
   uint8_t readRegisterByte(uint8_t regStartAddr);
   uint16_t readRegisterWord(uint8_t regStartAddr);
 
   // Variable functions **********
-  boolean writeVariable(uint16_t varStartAddr, uint16_t *buffer, uint8_t buffLen);
+  boolean writeVariable(uint16_t varStartAddr, uint16_t *buffer, uint16_t buffLen);
+  boolean writeVariableBytes(uint16_t varStartAddr, const uint8_t *buffer, uint16_t buffLen);
   boolean writeVariableWord(uint16_t varStartAddr, uint16_t w);
 
-  boolean readVariable(uint16_t varStartAddr, uint16_t *dest_buffer, uint8_t buffLen);
+  boolean readVariable(uint16_t varStartAddr, uint16_t *dest_buffer, uint16_t buffLen);
   uint16_t readVariableWord(uint16_t varStartAddr);
 
+  // Async read functions ********
+  int8_t  requestRegisterRead(uint8_t regStartAddr, void *dest_buffer, uint8_t buffLen, StoneLCDReadCallback callback = NULL);
+  int8_t  requestVariableRead(uint16_t varStartAddr, uint16_t *dest_buffer, uint8_t buffLen, StoneLCDReadCallback callback = NULL);
+  uint8_t getReadStatus(int8_t handle, boolean pollFirst = true);
+  uint8_t getPendingReadCount();
+
+  // Variable cache functions ****
+  boolean  cacheVariable(uint16_t varAddr);
+  void     invalidateVariableCache();
+  uint32_t getCacheHits();
+  uint32_t getCacheMisses();
+  void     resetCacheStats();
+
+  // Curve buffer functions ******
+  boolean writeCurveBuffer(uint8_t channelMask, uint16_t *samples, uint8_t sampleCount);
+  boolean clearCurveBuffer(uint8_t channel);
+  boolean clearAllCurveBuffers();
+
+  // Raw frame functions *********
+  boolean startFrame(uint8_t cmd, uint8_t len);
+  boolean addFrameByte(uint8_t b);
+  boolean addFrameWord(uint16_t w);
+  boolean finishFrame();
+
+  // Frame scripts ***************
+  boolean runScript(const uint8_t *script, const uint16_t *params = NULL, uint8_t paramCount = 0);
+
   // RTC functions ***************
   boolean getRTC(StoneLCDDateTime *dst);
   boolean setRTC(StoneLCDDateTime *src);
+
+  // Status functions ************
+  boolean getStatus(StoneLCDStatus *dst);
   
   // Page/Pic functions ***********
   boolean setCurrentPage(uint16_t picId);
   uint16_t getCurrentPage();
   
   // Sound functions *************
+  boolean beep(uint8_t time);
   boolean playSound(uint16_t soundId, uint8_t volume);
   boolean stopSound(uint16_t soundId);
   uint8_t getSoundPlaybackStatus();
 
+  // Event dispatch functions ****
+  boolean onEvent(uint16_t address, StoneLCDEventHandler handler);
+  boolean onEventRange(uint16_t firstAddress, uint16_t lastAddress, StoneLCDEventHandler handler);
+  void    onUnhandledEvent(StoneLCDEventHandler handler);
+  uint16_t getDroppedEventCount();
+
   // I/O Stream functions ********
+  uint8_t poll();
   boolean checkForIOEvent(StoneLCDEvent *dst, uint16_t *dataDest, uint8_t maxLen);
+  boolean checkForFrame(StoneLCDFrame *dst);
   void    clearInputStream();
 };
 #endif
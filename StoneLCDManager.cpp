@@ -0,0 +1,223 @@
+// ************************************************
+// StoneLCDManager.cpp                           **
+// ***************************************************************************
+/* Implementation of StoneLCDManager; cooperative, round-robin service of
+ * several Stone HMI Displays (one StoneLCD per port) from a single poll()
+ * call. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDManager.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                       S t o n e L C D M a n a g e r                    ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDManager::StoneLCDManager() {
+  this->displayCount = 0;
+  this->nextDisplay = 0;
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+boolean StoneLCDManager::enqueue(uint8_t display, uint8_t type, uint16_t address, void *buffer, uint8_t len, StoneLCDRequestCallback callback) {
+  StoneLCDManagedDisplay *d;
+  StoneLCDRequest *req;
+
+  if (display >= this->displayCount || buffer == NULL || len == 0) return false;
+  d = &this->displays[display];
+  if (d->count >= STONE_MANAGER_QUEUE_SIZE) return false;
+
+  req = &d->queue[(d->head + d->count) % STONE_MANAGER_QUEUE_SIZE];
+  req->type = type;
+  req->address = address;
+  req->len = len;
+  req->buffer = buffer;
+  req->callback = callback;
+  d->count++;
+  return true;
+}
+
+// Bytes the frame of a request takes, header and CRC included
+uint16_t StoneLCDManager::frameBytes(uint8_t display, StoneLCDRequest *req) {
+  uint16_t bytes = this->displays[display].lcd->isCRCEnabled() ? 2 + 1 + 2 : 2 + 1;   // Header (2) + length (1) + CRC (2)
+
+  switch (req->type) {
+    case STONE_REQ_REGISTER_READ:  return bytes + 3;                              // cmd (1) + address (1) + length (1)
+    case STONE_REQ_VARIABLE_READ:  return bytes + 4;                              // cmd (1) + address (2) + length (1)
+    case STONE_REQ_REGISTER_WRITE: return bytes + 2 + req->len;                   // cmd (1) + address (1) + data
+    default:                       return bytes + 3 + ((uint16_t)req->len << 1);  // cmd (1) + address (2) + data
+  }
+}
+
+// Reports the reads of a display that are over, as of its last poll().
+// Returns how many were.
+uint8_t StoneLCDManager::collectReads(uint8_t display) {
+  uint8_t h, status, done = 0;
+  StoneLCDManagedDisplay *d = &this->displays[display];
+
+  for (h = 0; h < STONE_MAX_PENDING_READS && d->inFlightMask != 0; h++) {
+    if (!(d->inFlightMask & ((StoneLCDSlotMask)1 << h))) continue;
+    status = d->lcd->getReadStatus(h, false);
+    if (status == STONE_READ_PENDING) continue;
+    d->inFlightMask &= ~((StoneLCDSlotMask)1 << h);
+    done++;
+    if (d->inFlight[h].callback != NULL) d->inFlight[h].callback(display, &d->inFlight[h], status == STONE_READ_DONE);
+  }
+  return done;
+}
+
+// Sends the oldest queued request of a display. Reads are sent without
+// waiting for the reply; if every read slot of the display is in use, the
+// request stays queued until one is released. With a TX queue, requests
+// also stay queued until their frame fits in it, so they never wait for the
+// port. Writes are over once sent, and so are reads that couldn't be sent
+// for any other reason (their callback is told they failed), so this
+// returns 1 for them (requests completed), and 0 otherwise.
+uint8_t StoneLCDManager::issueNext(uint8_t display) {
+  uint8_t done = 0;
+  int8_t h;
+  boolean ok;
+  StoneLCDManagedDisplay *d = &this->displays[display];
+  StoneLCDRequest *req;
+
+  if (d->count == 0) return 0;
+  req = &d->queue[d->head];
+#if STONE_TX_QUEUE_SIZE > 0
+  if (d->lcd->getTxRoom() < this->frameBytes(display, req)) return 0;
+#endif
+  switch (req->type) {
+    case STONE_REQ_REGISTER_READ:
+    case STONE_REQ_VARIABLE_READ:
+      if (req->type == STONE_REQ_REGISTER_READ) {
+        h = d->lcd->requestRegisterRead((uint8_t)req->address, req->buffer, req->len);
+      } else {
+        h = d->lcd->requestVariableRead(req->address, (uint16_t *)req->buffer, req->len);
+      }
+      if (h < 0 && d->lcd->getLastError() == STONE_ERR_NO_SLOT) return 0;
+      if (h < 0) {
+        // Any other error wouldn't go away by trying again
+        if (req->callback != NULL) req->callback(display, req, false);
+        done = 1;
+        break;
+      }
+      d->inFlight[h] = *req;
+      d->inFlightMask |= ((StoneLCDSlotMask)1 << h);
+      break;
+
+    default:
+      if (req->type == STONE_REQ_REGISTER_WRITE) {
+        ok = d->lcd->writeRegister((uint8_t)req->address, (uint8_t *)req->buffer, req->len);
+      } else {
+        ok = d->lcd->writeVariable(req->address, (uint16_t *)req->buffer, req->len);
+      }
+      if (req->callback != NULL) req->callback(display, req, ok);
+      done = 1;
+      break;
+  }
+  d->head = (d->head + 1) % STONE_MANAGER_QUEUE_SIZE;
+  d->count--;
+  return done;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+StoneLCD *StoneLCDManager::getDisplay(uint8_t display) {
+  return display < this->displayCount ? this->displays[display].lcd : NULL;
+}
+
+uint8_t StoneLCDManager::getDisplayCount() {
+  return this->displayCount;
+}
+
+uint8_t StoneLCDManager::getQueueLength(uint8_t display) {
+  return display < this->displayCount ? this->displays[display].count : 0;
+}
+
+// True when no display has requests queued or reads in flight
+boolean StoneLCDManager::isIdle() {
+  uint8_t i;
+  for (i = 0; i < this->displayCount; i++) {
+    if (this->displays[i].count > 0 || this->displays[i].inFlightMask != 0) return false;
+  }
+  return true;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// Returns the display number, or -1 if there's no room for more
+int8_t StoneLCDManager::addDisplay(StoneLCD *lcd) {
+  StoneLCDManagedDisplay *d;
+
+  if (lcd == NULL || this->displayCount >= STONE_MANAGER_MAX_DISPLAYS) return -1;
+  d = &this->displays[this->displayCount];
+  d->lcd = lcd;
+  d->head = 0;
+  d->count = 0;
+  d->inFlightMask = 0;
+  return this->displayCount++;
+}
+
+// Requests are sent by poll(), in the order they were queued. Buffers must
+// stay valid until the request's callback is called. Requests without a
+// buffer or with a len of 0 are refused.
+boolean StoneLCDManager::queueRegisterRead(uint8_t display, uint8_t address, void *dest, uint8_t len, StoneLCDRequestCallback callback) {
+  if (len > STONE_REG_READ_MAX_BYTES) return false;
+  return this->enqueue(display, STONE_REQ_REGISTER_READ, address, dest, len, callback);
+}
+
+boolean StoneLCDManager::queueVariableRead(uint8_t display, uint16_t address, uint16_t *dest, uint8_t len, StoneLCDRequestCallback callback) {
+  if (len > STONE_VAR_READ_MAX_WORDS) return false;
+  return this->enqueue(display, STONE_REQ_VARIABLE_READ, address, dest, len, callback);
+}
+
+#if STONE_TX_QUEUE_SIZE > 0
+// Writes whose frame wouldn't fit in the TX queue are refused, since they
+// would have to wait for the port.
+boolean StoneLCDManager::queueRegisterWrite(uint8_t display, uint8_t address, uint8_t *src, uint8_t len, StoneLCDRequestCallback callback) {
+  StoneLCDRequest req;
+
+  req.type = STONE_REQ_REGISTER_WRITE;
+  req.len = len;
+  if (display >= this->displayCount || this->frameBytes(display, &req) > STONE_TX_QUEUE_SIZE) return false;
+  return this->enqueue(display, STONE_REQ_REGISTER_WRITE, address, src, len, callback);
+}
+
+boolean StoneLCDManager::queueVariableWrite(uint8_t display, uint16_t address, uint16_t *src, uint8_t len, StoneLCDRequestCallback callback) {
+  StoneLCDRequest req;
+
+  req.type = STONE_REQ_VARIABLE_WRITE;
+  req.len = len;
+  if (display >= this->displayCount || this->frameBytes(display, &req) > STONE_TX_QUEUE_SIZE) return false;
+  return this->enqueue(display, STONE_REQ_VARIABLE_WRITE, address, src, len, callback);
+}
+#endif
+
+// Gives every display a turn: its incoming data is processed (replies,
+// events and handlers, as StoneLCD::poll() does), finished reads are
+// reported, and one queued request is sent. No call waits for a display, so
+// a slow one doesn't hold back the rest (writes need the TX queue for that,
+// see STONE_TX_QUEUE_SIZE). The display served first rotates on
+// every call. Returns the number of requests completed.
+uint8_t StoneLCDManager::poll() {
+  uint8_t i, display, done = 0;
+
+  for (i = 0; i < this->displayCount; i++) {
+    display = (this->nextDisplay + i) % this->displayCount;
+    this->displays[display].lcd->poll();
+    done += this->collectReads(display);
+    done += this->issueNext(display);
+  }
+  if (this->displayCount > 0) this->nextDisplay = (this->nextDisplay + 1) % this->displayCount;
+  return done;
+}
@@ -0,0 +1,112 @@
+// ************************************************
+// StoneLCDManager.h                             **
+// ***************************************************************************
+/* Header for StoneLCDManager; cooperative, round-robin service of several
+ * Stone HMI Displays (one StoneLCD per port) from a single poll() call.
+ * Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_MANAGER_H__
+#define _STONE_LCD_MANAGER_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+#ifndef STONE_MANAGER_MAX_DISPLAYS
+#define STONE_MANAGER_MAX_DISPLAYS      4
+#endif
+
+// Requests each display can have waiting to be sent
+#ifndef STONE_MANAGER_QUEUE_SIZE
+#define STONE_MANAGER_QUEUE_SIZE        4
+#endif
+
+// Read slots (handles) of each display are tracked in a bit mask
+#if STONE_MAX_PENDING_READS > 32
+#error "StoneLCDManager can't track more than 32 read slots (STONE_MAX_PENDING_READS)"
+#elif STONE_MAX_PENDING_READS > 16
+typedef uint32_t StoneLCDSlotMask;
+#elif STONE_MAX_PENDING_READS > 8
+typedef uint16_t StoneLCDSlotMask;
+#else
+typedef uint8_t  StoneLCDSlotMask;
+#endif
+
+// --- Request types -------------------------------------------
+#define STONE_REQ_REGISTER_READ         0
+#define STONE_REQ_VARIABLE_READ         1
+#define STONE_REQ_REGISTER_WRITE        2
+#define STONE_REQ_VARIABLE_WRITE        3
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+struct StoneLCDRequest;
+
+// Called when a queued request is over. For writes, success only means the
+// frame was sent.
+typedef void (*StoneLCDRequestCallback)(uint8_t display, struct StoneLCDRequest *req, boolean success);
+
+typedef struct StoneLCDRequest {
+  uint8_t  type;           // STONE_REQ_xxx
+  uint16_t address;
+  uint8_t  len;            // Bytes for registers, words for variables
+  void     *buffer;        // Destination of reads, source of writes
+  StoneLCDRequestCallback callback;
+} StoneLCDRequest;
+
+typedef struct {
+  StoneLCD *lcd;
+  uint8_t  head, count;
+  StoneLCDRequest queue[STONE_MANAGER_QUEUE_SIZE];
+  StoneLCDSlotMask inFlightMask; // Read slots (handles) used by this manager
+  StoneLCDRequest inFlight[STONE_MAX_PENDING_READS];
+} StoneLCDManagedDisplay;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                       S t o n e L C D M a n a g e r                    ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDManager {
+private:
+  uint8_t  displayCount;
+  uint8_t  nextDisplay;    // First display served by the next poll()
+  StoneLCDManagedDisplay displays[STONE_MANAGER_MAX_DISPLAYS];
+
+  boolean  enqueue(uint8_t display, uint8_t type, uint16_t address, void *buffer, uint8_t len, StoneLCDRequestCallback callback);
+  uint8_t  collectReads(uint8_t display);
+  uint8_t  issueNext(uint8_t display);
+  uint16_t frameBytes(uint8_t display, StoneLCDRequest *req);
+
+public:
+  StoneLCDManager();
+
+  int8_t   addDisplay(StoneLCD *lcd);
+  StoneLCD *getDisplay(uint8_t display);
+  uint8_t  getDisplayCount();
+
+  boolean  queueRegisterRead(uint8_t display, uint8_t address, void *dest, uint8_t len, StoneLCDRequestCallback callback = NULL);
+  boolean  queueVariableRead(uint8_t display, uint16_t address, uint16_t *dest, uint8_t len, StoneLCDRequestCallback callback = NULL);
+#if STONE_TX_QUEUE_SIZE > 0
+  // Writes need the TX queue (STONE_TX_QUEUE_SIZE), or they would wait for
+  // the port.
+  boolean  queueRegisterWrite(uint8_t display, uint8_t address, uint8_t *src, uint8_t len, StoneLCDRequestCallback callback = NULL);
+  boolean  queueVariableWrite(uint8_t display, uint16_t address, uint16_t *src, uint8_t len, StoneLCDRequestCallback callback = NULL);
+#endif
+  uint8_t  getQueueLength(uint8_t display);
+  boolean  isIdle();
+
+  uint8_t  poll();
+};
+#endif
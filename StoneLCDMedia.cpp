@@ -0,0 +1,253 @@
+// ************************************************
+// StoneLCDMedia.cpp                             **
+// ***************************************************************************
+/* Implementation of StoneLCDMedia; video and audio playback control, with
+ * state tracking and playlists, for Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDMedia.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            M A C R O S                                 ##
+ *##                                                                        ##
+ *############################################################################*/
+#define tryOrReturnFalse(f)         if(!(f)) return false
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D M e d i a                      ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDMedia::StoneLCDMedia(StoneLCD *display) {
+  this->lcd = display;
+  this->pollIntervalMs = STONE_MEDIA_DEFAULT_INTERVAL;
+  this->lastPollAt = 0;
+  this->pollHandle = -1;
+  this->videoVolume = 0x3F;
+  this->soundVolume = 0x40;
+  this->finishedCallback = NULL;
+  memset(this->channels, 0, sizeof(this->channels));
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+// A video setup (type, position, number and volume) goes in a single frame
+// covering registers 0x60 - 0x69. A clip still active on the channel counts
+// as finished once the new one was started.
+boolean StoneLCDMedia::start(uint8_t channel, StoneLCDMediaItem *item) {
+  uint8_t regs[STONE_REG_AVI_VOL - STONE_REG_PLAY_AVI_SET + 1];
+  StoneLCDMediaChannel *ch = &this->channels[channel];
+  boolean replaced = ch->active;
+  uint16_t previous = ch->current.number;
+
+  if (channel == STONE_MEDIA_VIDEO) {
+    regs[0] = 0x5A;                          // Apply
+    regs[1] = item->type;
+    regs[2] = (uint8_t)(item->x >> 8);
+    regs[3] = (uint8_t)(item->x & 0xff);
+    regs[4] = (uint8_t)(item->y >> 8);
+    regs[5] = (uint8_t)(item->y & 0xff);
+    regs[6] = (uint8_t)(item->number >> 8);
+    regs[7] = (uint8_t)(item->number & 0xff);
+    regs[8] = 0x5A;                          // Adjust volume
+    regs[9] = this->videoVolume;
+    tryOrReturnFalse (this->lcd->writeRegister(STONE_REG_PLAY_AVI_SET, regs, sizeof(regs)));
+  } else {
+    tryOrReturnFalse (this->lcd->playSound(item->number, this->soundVolume));
+  }
+  ch->current = *item;
+  ch->active = true;
+  ch->seenPlaying = false;
+  ch->startedAt = millis();
+  if (replaced && this->finishedCallback != NULL) this->finishedCallback(channel, previous);
+  return true;
+}
+
+boolean StoneLCDMedia::enqueue(uint8_t channel, StoneLCDMediaItem *item) {
+  StoneLCDMediaChannel *ch = &this->channels[channel];
+
+  if (ch->count >= STONE_MEDIA_QUEUE_SIZE) return false;
+  ch->queue[(ch->head + ch->count) % STONE_MEDIA_QUEUE_SIZE] = *item;
+  ch->count++;
+  return true;
+}
+
+// Updates a channel with its reported state. A clip is over once the display
+// has reported it playing and then stopped (or if it never started), and
+// then the next one in the playlist is started. If that fails, it stays in
+// the playlist for the next status update, and this returns false.
+boolean StoneLCDMedia::trackChannel(uint8_t channel, uint8_t reported) {
+  StoneLCDMediaChannel *ch = &this->channels[channel];
+
+  ch->state = reported;
+  if (ch->active) {
+    if (reported != STONE_MEDIA_STOPPED) {
+      ch->seenPlaying = true;
+    } else if (ch->seenPlaying || millis() - ch->startedAt >= STONE_MEDIA_START_TIMEOUT) {
+      ch->active = false;
+      if (this->finishedCallback != NULL) this->finishedCallback(channel, ch->current.number);
+    }
+  }
+
+  if (!ch->active && ch->count > 0 && ch->state == STONE_MEDIA_STOPPED) {
+    tryOrReturnFalse (this->start(channel, &ch->queue[ch->head]));
+    ch->head = (ch->head + 1) % STONE_MEDIA_QUEUE_SIZE;
+    ch->count--;
+  }
+  return true;
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+// Time between status polls done by update()
+void StoneLCDMedia::setPollIntervalMs(uint16_t ms) {
+  this->pollIntervalMs = ms;
+}
+
+void StoneLCDMedia::onFinished(StoneLCDMediaCallback callback) {
+  this->finishedCallback = callback;
+}
+
+// Volume for the sounds played from here on (0x00 - 0x40)
+void StoneLCDMedia::setSoundVolume(uint8_t volume) {
+  this->soundVolume = volume;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+// STONE_MEDIA_STOPPED, STONE_MEDIA_PLAYING or STONE_MEDIA_PAUSED, as of the
+// last status poll
+uint8_t StoneLCDMedia::getState(uint8_t channel) {
+  if (channel > STONE_MEDIA_VIDEO) return STONE_MEDIA_STOPPED;
+  return this->channels[channel].state;
+}
+
+uint8_t StoneLCDMedia::getQueueLength(uint8_t channel) {
+  if (channel > STONE_MEDIA_VIDEO) return 0;
+  return this->channels[channel].count;
+}
+
+// ****************************************************
+// ** "Video" Methods
+// ****************************************************
+// Plays a video right away, replacing whatever was playing. The playlist is
+// kept, and continues when this video is over.
+boolean StoneLCDMedia::playVideo(uint16_t number, uint16_t x, uint16_t y, uint8_t type) {
+  StoneLCDMediaItem item = {number, x, y, type};
+  return this->start(STONE_MEDIA_VIDEO, &item);
+}
+
+// Adds a video to the playlist. It starts once the previous ones are over.
+boolean StoneLCDMedia::queueVideo(uint16_t number, uint16_t x, uint16_t y, uint8_t type) {
+  StoneLCDMediaItem item = {number, x, y, type};
+  return this->enqueue(STONE_MEDIA_VIDEO, &item);
+}
+
+// Range: 0x00 - 0x3F. Also used for the videos played from here on.
+boolean StoneLCDMedia::setVideoVolume(uint8_t volume) {
+  uint8_t regs[2];
+
+  this->videoVolume = volume;
+  regs[0] = 0x5A;
+  regs[1] = volume;
+  return this->lcd->writeRegister(STONE_REG_AVI_VOL_ADJ_EN, regs, 2);
+}
+
+// STONE_REG_PLAY_CONTROL toggles between playing and paused, so these only
+// write it when the video is known to be in the other state.
+boolean StoneLCDMedia::pauseVideo() {
+  if (this->channels[STONE_MEDIA_VIDEO].state != STONE_MEDIA_PLAYING) return false;
+  tryOrReturnFalse (this->lcd->writeRegisterByte(STONE_REG_PLAY_CONTROL, 0x5A));
+  this->channels[STONE_MEDIA_VIDEO].state = STONE_MEDIA_PAUSED;
+  return true;
+}
+
+boolean StoneLCDMedia::resumeVideo() {
+  if (this->channels[STONE_MEDIA_VIDEO].state != STONE_MEDIA_PAUSED) return false;
+  tryOrReturnFalse (this->lcd->writeRegisterByte(STONE_REG_PLAY_CONTROL, 0x5A));
+  this->channels[STONE_MEDIA_VIDEO].state = STONE_MEDIA_PLAYING;
+  return true;
+}
+
+// Stops the video and clears the playlist
+boolean StoneLCDMedia::stopVideo() {
+  this->clearQueue(STONE_MEDIA_VIDEO);
+  return this->skip(STONE_MEDIA_VIDEO);
+}
+
+// ****************************************************
+// ** "Audio" Methods
+// ****************************************************
+boolean StoneLCDMedia::playSound(uint16_t soundId) {
+  StoneLCDMediaItem item = {soundId, 0, 0, 0};
+  return this->start(STONE_MEDIA_AUDIO, &item);
+}
+
+boolean StoneLCDMedia::queueSound(uint16_t soundId) {
+  StoneLCDMediaItem item = {soundId, 0, 0, 0};
+  return this->enqueue(STONE_MEDIA_AUDIO, &item);
+}
+
+// Stops the sound and clears the playlist
+boolean StoneLCDMedia::stopSound() {
+  this->clearQueue(STONE_MEDIA_AUDIO);
+  return this->skip(STONE_MEDIA_AUDIO);
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// Stops the current clip. The playlist moves on to the next one.
+boolean StoneLCDMedia::skip(uint8_t channel) {
+  if (channel > STONE_MEDIA_VIDEO) return false;
+  if (channel == STONE_MEDIA_VIDEO) {
+    tryOrReturnFalse (this->lcd->writeRegisterByte(STONE_REG_PLAY_STOP, 0x5A));
+  } else {
+    tryOrReturnFalse (this->lcd->stopSound(this->channels[channel].current.number));
+  }
+  return true;
+}
+
+void StoneLCDMedia::clearQueue(uint8_t channel) {
+  if (channel > STONE_MEDIA_VIDEO) return;
+  this->channels[channel].head = 0;
+  this->channels[channel].count = 0;
+}
+
+// Call this often (e.g. from loop()). It never waits for the display: every
+// poll interval it requests both playback status registers with a single
+// read, and processes the reply on a later call. Returns true when a status
+// update was processed, and false if starting the next clip of a playlist
+// failed then (it's tried again with the next update).
+boolean StoneLCDMedia::update() {
+  uint8_t status;
+  boolean ok;
+
+  if (this->pollHandle >= 0) {
+    status = this->lcd->getReadStatus(this->pollHandle);
+    if (status == STONE_READ_PENDING) return false;
+    this->pollHandle = -1;
+    if (status != STONE_READ_DONE) return false;
+
+    // Audio: 0x00 = Stop, 0x01 = Play. Video: 0x00 = Idle, 0x01 = Playing, 0x02 = Paused
+    ok = this->trackChannel(STONE_MEDIA_AUDIO, this->statusRegs[0] ? STONE_MEDIA_PLAYING : STONE_MEDIA_STOPPED);
+    ok = this->trackChannel(STONE_MEDIA_VIDEO, this->statusRegs[STONE_MEDIA_STATUS_SIZE - 1]) && ok;
+    return ok;
+  }
+
+  if (millis() - this->lastPollAt < this->pollIntervalMs) return false;
+  this->lastPollAt = millis();
+  this->pollHandle = this->lcd->requestRegisterRead(STONE_MEDIA_STATUS_FIRST, this->statusRegs, STONE_MEDIA_STATUS_SIZE);
+  return false;
+}
@@ -0,0 +1,125 @@
+// ************************************************
+// StoneLCDMedia.h                               **
+// ***************************************************************************
+/* Header for StoneLCDMedia; video and audio playback control, with state
+ * tracking and playlists, for Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_MEDIA_H__
+#define _STONE_LCD_MEDIA_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Items each playlist (audio and video) can hold
+#ifndef STONE_MEDIA_QUEUE_SIZE
+#define STONE_MEDIA_QUEUE_SIZE          4
+#endif
+
+#define STONE_MEDIA_DEFAULT_INTERVAL    100  // ms between status polls
+#define STONE_MEDIA_START_TIMEOUT       1000 // ms for a clip to be reported as playing
+
+// Both status registers (0x55 for audio, 0x6D for video) are read together
+#define STONE_MEDIA_STATUS_FIRST        STONE_REG_VOL_STATUS
+#define STONE_MEDIA_STATUS_SIZE         (STONE_REG_PLAY_STATUS - STONE_REG_VOL_STATUS + 1)
+
+#if STONE_REG_READ_MAX_BYTES < STONE_MEDIA_STATUS_SIZE
+#error "STONE_RX_BUFFER_SIZE is too small for StoneLCDMedia status reads"
+#endif
+
+// --- Channels ------------------------------------------------
+#define STONE_MEDIA_AUDIO               0
+#define STONE_MEDIA_VIDEO               1
+
+// --- Playback states -----------------------------------------
+#define STONE_MEDIA_STOPPED             0
+#define STONE_MEDIA_PLAYING             1
+#define STONE_MEDIA_PAUSED              2
+
+// --- STONE_REG_PLAY_AVI_TYPE values --------------------------
+#define STONE_AVI_SINGLE_LCD            0x00
+#define STONE_AVI_SINGLE_USB            0x01
+#define STONE_AVI_SEQUENCE_LCD          0x02
+#define STONE_AVI_SEQUENCE_USB          0x03
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+typedef struct {
+  uint16_t number;
+  uint16_t x, y;           // Video only
+  uint8_t  type;           // Video only (STONE_AVI_xxx)
+} StoneLCDMediaItem;
+
+typedef struct {
+  uint8_t  state;          // As last reported by the display
+  boolean  active;         // A clip was started and hasn't finished yet
+  boolean  seenPlaying;    // ... and the display has reported it playing
+  unsigned long startedAt;
+  StoneLCDMediaItem current;
+  uint8_t  head, count;
+  StoneLCDMediaItem queue[STONE_MEDIA_QUEUE_SIZE];
+} StoneLCDMediaChannel;
+
+// Called when a clip started by StoneLCDMedia finishes, or is replaced by
+// another one played right away
+typedef void (*StoneLCDMediaCallback)(uint8_t channel, uint16_t number);
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D M e d i a                      ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDMedia {
+private:
+  StoneLCD *lcd;
+  uint16_t pollIntervalMs;
+  unsigned long lastPollAt;
+  int8_t   pollHandle;
+  uint8_t  statusRegs[STONE_MEDIA_STATUS_SIZE];
+  uint8_t  videoVolume, soundVolume;
+  StoneLCDMediaChannel channels[2];
+  StoneLCDMediaCallback finishedCallback;
+
+  boolean  start(uint8_t channel, StoneLCDMediaItem *item);
+  boolean  enqueue(uint8_t channel, StoneLCDMediaItem *item);
+  boolean  trackChannel(uint8_t channel, uint8_t reported);
+
+public:
+  StoneLCDMedia(StoneLCD *display);
+
+  void setPollIntervalMs(uint16_t ms);
+  void onFinished(StoneLCDMediaCallback callback);
+
+  // Video
+  boolean playVideo(uint16_t number, uint16_t x, uint16_t y, uint8_t type = STONE_AVI_SINGLE_LCD);
+  boolean queueVideo(uint16_t number, uint16_t x, uint16_t y, uint8_t type = STONE_AVI_SINGLE_LCD);
+  boolean setVideoVolume(uint8_t volume);
+  boolean pauseVideo();
+  boolean resumeVideo();
+  boolean stopVideo();
+
+  // Audio
+  boolean playSound(uint16_t soundId);
+  boolean queueSound(uint16_t soundId);
+  void    setSoundVolume(uint8_t volume);
+  boolean stopSound();
+
+  boolean skip(uint8_t channel);
+  void    clearQueue(uint8_t channel);
+  uint8_t getQueueLength(uint8_t channel);
+  uint8_t getState(uint8_t channel);
+
+  boolean update();
+};
+#endif
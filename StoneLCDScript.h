@@ -0,0 +1,59 @@
+// ************************************************
+// StoneLCDScript.h                              **
+// ***************************************************************************
+/* Macros to declare frame scripts: fixed series of frames (page changes,
+ * variable and register writes, sounds) kept in flash and sent with a
+ * single StoneLCD::runScript() call. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_SCRIPT_H__
+#define _STONE_LCD_SCRIPT_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Each step of a script is stored as:
+//   cmd, payload length, slot position, slot index, payload...
+// where the payload is everything after the cmd byte (address and data).
+// If the slot index isn't STONE_SCRIPT_NO_PARAM, the word at "slot
+// position" of the payload is replaced with that entry of the parameters
+// passed to runScript(). Scripts end with STONE_SCRIPT_END.
+#define STONE_SCRIPT_HI(w)                     ((uint8_t)((uint16_t)(w) >> 8))
+#define STONE_SCRIPT_LO(w)                     ((uint8_t)((uint16_t)(w) & 0xff))
+
+// --- Steps ---------------------------------------------------
+#define STONE_SCRIPT_PAGE(page)                STONE_CMD_REGISTER_WRITE, 3, 0, STONE_SCRIPT_NO_PARAM, \
+                                               STONE_REG_PIC_ID, STONE_SCRIPT_HI(page), STONE_SCRIPT_LO(page)
+#define STONE_SCRIPT_PAGE_PARAM(slot)          STONE_CMD_REGISTER_WRITE, 3, 1, (slot), \
+                                               STONE_REG_PIC_ID, 0, 0
+
+#define STONE_SCRIPT_VAR_WORD(addr, value)     STONE_CMD_VARIABLE_WRITE, 4, 0, STONE_SCRIPT_NO_PARAM, \
+                                               STONE_SCRIPT_HI(addr), STONE_SCRIPT_LO(addr), STONE_SCRIPT_HI(value), STONE_SCRIPT_LO(value)
+#define STONE_SCRIPT_VAR_PARAM(addr, slot)     STONE_CMD_VARIABLE_WRITE, 4, 2, (slot), \
+                                               STONE_SCRIPT_HI(addr), STONE_SCRIPT_LO(addr), 0, 0
+
+// Several contiguous variables: must be followed by "count" STONE_SCRIPT_WORD()
+#define STONE_SCRIPT_VARS(addr, count)         STONE_CMD_VARIABLE_WRITE, 2 + ((count) << 1), 0, STONE_SCRIPT_NO_PARAM, \
+                                               STONE_SCRIPT_HI(addr), STONE_SCRIPT_LO(addr)
+#define STONE_SCRIPT_WORD(value)               STONE_SCRIPT_HI(value), STONE_SCRIPT_LO(value)
+
+#define STONE_SCRIPT_REG_BYTE(reg, value)      STONE_CMD_REGISTER_WRITE, 2, 0, STONE_SCRIPT_NO_PARAM, (reg), (value)
+
+#define STONE_SCRIPT_SOUND(id, volume)         STONE_CMD_REGISTER_WRITE, 6, 0, STONE_SCRIPT_NO_PARAM, \
+                                               STONE_REG_MUSIC_SET, 0x5B, STONE_SCRIPT_HI(id), STONE_SCRIPT_LO(id), 0x54, (volume)
+#define STONE_SCRIPT_SOUND_PARAM(slot, volume) STONE_CMD_REGISTER_WRITE, 6, 2, (slot), \
+                                               STONE_REG_MUSIC_SET, 0x5B, 0, 0, 0x54, (volume)
+
+#define STONE_SCRIPT_BEEP(time)                STONE_SCRIPT_REG_BYTE(STONE_REG_BZ_TIME, time)
+
+#define STONE_SCRIPT_END                       STONE_SCRIPT_END_CMD
+
+#endif
@@ -0,0 +1,356 @@
+// ************************************************
+// StoneLCDSim.cpp                               **
+// ***************************************************************************
+/* Implementation of StoneLCDSim; a simulated Stone HMI Display that can be
+ * used in place of the serial port to run and measure StoneLCDLib code
+ * without a panel. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDSim.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            M A C R O S                                 ##
+ *##                                                                        ##
+ *############################################################################*/
+#define wordFromBytes(h,l)          ((h<<8) | (l))
+#define timeReached(t, now)         ((long)((now) - (t)) >= 0)
+
+/*############################################################################
+ *##                                                                        ##
+ *##                           S t o n e L C D S i m                        ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDSim::StoneLCDSim(uint32_t baudRate, uint8_t cmdHi, uint8_t cmdLo, boolean crcMode) {
+  uint16_t i;
+
+  this->cmdFrameHSB = cmdHi;
+  this->cmdFrameLSB = cmdLo;
+  this->useCRC = crcMode;
+  this->setBaudRate(baudRate);
+  this->responseUs = STONE_SIM_DEFAULT_RESPONSE_US;
+  this->hostLineFreeAt = 0;
+  this->displayLineFreeAt = 0;
+  this->inCount = 0;
+  this->outHead = 0;
+  this->outCount = 0;
+  this->replyHead = 0;
+  this->replyCount = 0;
+  this->dblUs = STONE_SIM_DEFAULT_DBL_US;
+  this->dblRunning = false;
+  for (i = 0; i < 256; i++) this->registers[i] = 0;
+  for (i = 0; i < STONE_SIM_VARIABLES; i++) this->variables[i] = 0;
+  for (i = 0; i < STONE_SIM_FLASH_WORDS; i++) this->flash[i] = 0;
+  this->resetStats();
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+// Collects the bytes sent by the host until a whole frame is in
+void StoneLCDSim::receiveByte(uint8_t b) {
+  if (this->inCount == 0 && b != this->cmdFrameHSB) return;
+  if (this->inCount == 1 && b != this->cmdFrameLSB) {
+    this->inCount = (b == this->cmdFrameHSB) ? 1 : 0;
+    return;
+  }
+  this->inFrame[this->inCount++] = b;
+  if (this->inCount >= 3 && this->inCount == 3 + this->inFrame[2]) {
+    this->processFrame();
+    this->inCount = 0;
+  }
+}
+
+void StoneLCDSim::processFrame() {
+  uint8_t i, n, len = this->inFrame[2];
+  uint8_t *body = &this->inFrame[3];
+  uint16_t address, crc;
+  unsigned long readyAt = this->lastByteAt + this->responseUs;
+
+  this->stats.hostFrames++;
+  if (this->useCRC) {
+    // Frames with a bad CRC are ignored, like the display does
+    if (len < 4) return;
+    for (crc = 0xFFFF, i = 0; i < len; i++) crc = CRC16Update(crc, body[i]);
+    if (crc != 0) return;
+    len -= 2;
+  }
+  if (len < 2) return;
+
+  switch (body[0]) {
+    case STONE_CMD_REGISTER_WRITE:
+      for (i = 2; i < len; i++) this->registers[(uint8_t)(body[1] + i - 2)] = body[i];
+      if (this->registers[STONE_REG_EN_DBL_OP] == 0x5A && !this->dblRunning) this->startDatabaseOp(this->lastByteAt);
+      break;
+
+    case STONE_CMD_REGISTER_READ:
+      if (len < 3) break;
+      n = body[2];
+      this->updateDatabaseOp(readyAt);
+      if (!this->beginReply(STONE_CMD_REGISTER_READ, 3 + n)) break; // cmd (1) + address (1) + length (1) + data
+      this->replyByte(body[1]);
+      this->replyByte(n);
+      for (i = 0; i < n; i++) this->replyByte(this->registers[(uint8_t)(body[1] + i)]);
+      this->endReply(readyAt);
+      break;
+
+    case STONE_CMD_VARIABLE_WRITE:
+      if (len < 3) break;
+      address = wordFromBytes(body[1], body[2]);
+      for (i = 3; i + 1 < len; i += 2) this->setVariable(address++, wordFromBytes(body[i], body[i + 1]));
+      break;
+
+    case STONE_CMD_VARIABLE_READ:
+      if (len < 4) break;
+      address = wordFromBytes(body[1], body[2]);
+      n = body[3];
+      if (!this->beginReply(STONE_CMD_VARIABLE_READ, 4 + (n<<1))) break; // cmd (1) + address (2) + length (1) + data
+      this->replyByte(body[1]);
+      this->replyByte(body[2]);
+      this->replyByte(n);
+      for (i = 0; i < n; i++) {
+        this->replyByte(this->getVariable(address + i) >> 8);
+        this->replyByte(this->getVariable(address + i) & 0xff);
+      }
+      this->endReply(readyAt);
+      break;
+
+    // Curve buffer writes only show up in the traffic counters
+  }
+}
+
+// Runs a database operation as set up in registers 0x56 - 0x5F. The data is
+// moved right away, but STONE_REG_EN_DBL_OP reads as busy (0x5A) until the
+// operation time has passed.
+void StoneLCDSim::startDatabaseOp(unsigned long at) {
+  uint8_t *r = &this->registers[STONE_REG_DBL_ADDRESS];
+  uint32_t address = ((uint32_t)r[0] << 24) | ((uint32_t)r[1] << 16) | ((uint32_t)r[2] << 8) | r[3];
+  uint16_t vp = wordFromBytes(this->registers[STONE_REG_DBL_VP], this->registers[STONE_REG_DBL_VP + 1]);
+  uint16_t i, len = wordFromBytes(this->registers[STONE_REG_DBL_OP_LENGTH], this->registers[STONE_REG_DBL_OP_LENGTH + 1]);
+
+  for (i = 0; i < len; i++) {
+    if (this->registers[STONE_REG_DBL_OP_MODE] == 0x50) {
+      if (address + i < STONE_SIM_FLASH_WORDS) this->flash[address + i] = this->getVariable(vp + i);
+    } else {
+      this->setVariable(vp + i, address + i < STONE_SIM_FLASH_WORDS ? this->flash[address + i] : 0);
+    }
+  }
+  this->dblRunning = true;
+  this->dblDoneAt = at + this->dblUs;
+}
+
+void StoneLCDSim::updateDatabaseOp(unsigned long now) {
+  if (!this->dblRunning || !timeReached(this->dblDoneAt, now)) return;
+  this->registers[STONE_REG_EN_DBL_OP] = 0;
+  this->dblRunning = false;
+}
+
+// Replies that don't fit in the output buffer are dropped, as if lost
+boolean StoneLCDSim::beginReply(uint8_t cmd, uint8_t len) {
+  uint16_t total = 3 + len + (this->useCRC ? 2 : 0);
+
+  if (this->replyCount >= STONE_SIM_MAX_REPLIES) return false;
+  if (this->outCount + total > STONE_SIM_REPLY_BUFFER_SIZE) return false;
+  this->replyStart = this->outCount;
+  this->replyByte(this->cmdFrameHSB);
+  this->replyByte(this->cmdFrameLSB);
+  this->replyByte(this->useCRC ? len + 2 : len);
+  this->replyCRC = 0xFFFF;
+  this->replyByte(cmd);
+  return true;
+}
+
+void StoneLCDSim::replyByte(uint8_t b) {
+  this->outBuffer[(this->outHead + this->outCount) % STONE_SIM_REPLY_BUFFER_SIZE] = b;
+  this->outCount++;
+  this->replyCRC = CRC16Update(this->replyCRC, b);
+}
+
+// Puts the reply on the display -> host line once it's free, one byte time
+// per byte.
+void StoneLCDSim::endReply(unsigned long readyAt) {
+  uint16_t crc = this->replyCRC;
+  uint16_t count;
+  unsigned long start;
+  StoneLCDSimReply *reply;
+
+  if (this->useCRC) {
+    this->replyByte(crc & 0xff);
+    this->replyByte(crc >> 8);
+  }
+  count = this->outCount - this->replyStart;
+  start = timeReached(this->displayLineFreeAt, readyAt) ? readyAt : this->displayLineFreeAt;
+  this->displayLineFreeAt = start + count * this->byteTimeUs;
+
+  reply = &this->replies[(this->replyHead + this->replyCount) % STONE_SIM_MAX_REPLIES];
+  reply->startUs = start + this->byteTimeUs;
+  reply->count = count;
+  this->replyCount++;
+
+  this->stats.displayBytes += count;
+  this->stats.displayFrames++;
+  this->stats.wireTimeUs += count * this->byteTimeUs;
+}
+
+// Bytes that have completely arrived at the host by now
+uint16_t StoneLCDSim::arrivedBytes() {
+  uint8_t r;
+  uint16_t total = 0;
+  unsigned long now = micros(), arrived;
+  StoneLCDSimReply *reply;
+
+  for (r = 0; r < this->replyCount; r++) {
+    reply = &this->replies[(this->replyHead + r) % STONE_SIM_MAX_REPLIES];
+    if (!timeReached(reply->startUs, now)) break;
+    arrived = (now - reply->startUs) / this->byteTimeUs + 1;
+    if (arrived < reply->count) return total + arrived;
+    total += reply->count;
+  }
+  return total;
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+// Each byte takes 10 bit times (start + 8 data + stop)
+void StoneLCDSim::setBaudRate(uint32_t baudRate) {
+  if (baudRate == 0) baudRate = 115200;
+  this->byteTimeUs = (10000000UL + baudRate - 1) / baudRate;
+}
+
+void StoneLCDSim::setResponseTimeUs(uint16_t us) {
+  this->responseUs = us;
+}
+
+void StoneLCDSim::setDatabaseTimeUs(uint32_t us) {
+  this->dblUs = us;
+}
+
+// ****************************************************
+// ** Display memory
+// ****************************************************
+void StoneLCDSim::setRegister(uint8_t address, uint8_t value) {
+  this->registers[address] = value;
+}
+
+uint8_t StoneLCDSim::getRegister(uint8_t address) {
+  return this->registers[address];
+}
+
+void StoneLCDSim::setVariable(uint16_t address, uint16_t value) {
+  if (address < STONE_SIM_VARIABLES) this->variables[address] = value;
+}
+
+uint16_t StoneLCDSim::getVariable(uint16_t address) {
+  return address < STONE_SIM_VARIABLES ? this->variables[address] : 0;
+}
+
+boolean StoneLCDSim::touchVariable(uint16_t address, uint16_t value) {
+  this->setVariable(address, value);
+  if (!this->beginReply(STONE_CMD_VARIABLE_READ, 6)) return false; // cmd (1) + address (2) + length (1) + data (2)
+  this->replyByte(address >> 8);
+  this->replyByte(address & 0xff);
+  this->replyByte(1);
+  this->replyByte(value >> 8);
+  this->replyByte(value & 0xff);
+  this->endReply(micros());
+  return true;
+}
+
+void StoneLCDSim::touchPanel(uint8_t status, uint16_t x, uint16_t y) {
+  this->registers[STONE_REG_TP_STATUS] = status;
+  this->registers[STONE_REG_TP_POSITION] = x >> 8;
+  this->registers[STONE_REG_TP_POSITION + 1] = x & 0xff;
+  this->registers[STONE_REG_TP_POSITION + 2] = y >> 8;
+  this->registers[STONE_REG_TP_POSITION + 3] = y & 0xff;
+  this->registers[STONE_REG_TP_FLAG] = 0x5A;
+}
+
+// ****************************************************
+// ** Traffic counters
+// ****************************************************
+void StoneLCDSim::getStats(StoneLCDSimStats *dst) {
+  if (dst != NULL) *dst = this->stats;
+}
+
+void StoneLCDSim::resetStats() {
+  this->stats.hostBytes = 0;
+  this->stats.hostFrames = 0;
+  this->stats.displayBytes = 0;
+  this->stats.displayFrames = 0;
+  this->stats.wireTimeUs = 0;
+}
+
+// ****************************************************
+// ** Stream interface
+// ****************************************************
+int StoneLCDSim::available() {
+  return this->arrivedBytes();
+}
+
+int StoneLCDSim::read() {
+  uint8_t b;
+  StoneLCDSimReply *reply;
+
+  if (this->arrivedBytes() == 0) return -1;
+  b = this->outBuffer[this->outHead];
+  this->outHead = (this->outHead + 1) % STONE_SIM_REPLY_BUFFER_SIZE;
+  this->outCount--;
+
+  // The next byte of the reply arrives one byte time after this one
+  reply = &this->replies[this->replyHead];
+  reply->startUs += this->byteTimeUs;
+  if (--reply->count == 0) {
+    this->replyHead = (this->replyHead + 1) % STONE_SIM_MAX_REPLIES;
+    this->replyCount--;
+  }
+  return b;
+}
+
+int StoneLCDSim::peek() {
+  if (this->arrivedBytes() == 0) return -1;
+  return this->outBuffer[this->outHead];
+}
+
+// Waits until everything written by the host is on the wire
+void StoneLCDSim::flush() {
+  while (!timeReached(this->hostLineFreeAt, micros()));
+}
+
+size_t StoneLCDSim::write(uint8_t b) {
+  return this->write(&b, 1);
+}
+
+// Bytes are never blocked here, but they reach the display (and the replies
+// start) only after their wire time.
+size_t StoneLCDSim::write(const uint8_t *buffer, size_t size) {
+  size_t i;
+  unsigned long now = micros();
+
+  if (timeReached(this->hostLineFreeAt, now)) this->hostLineFreeAt = now;
+  for (i = 0; i < size; i++) {
+    this->hostLineFreeAt += this->byteTimeUs;
+    this->lastByteAt = this->hostLineFreeAt;
+    this->receiveByte(buffer[i]);
+  }
+  this->stats.hostBytes += size;
+  this->stats.wireTimeUs += size * this->byteTimeUs;
+  return size;
+}
+
+// What's left of a host UART TX buffer, given the bytes still on the wire
+int StoneLCDSim::availableForWrite() {
+  unsigned long now = micros();
+  unsigned long pending;
+
+  if (timeReached(this->hostLineFreeAt, now)) return STONE_SIM_HOST_TX_BUFFER;
+  pending = (this->hostLineFreeAt - now) / this->byteTimeUs;
+  return pending >= STONE_SIM_HOST_TX_BUFFER ? 0 : STONE_SIM_HOST_TX_BUFFER - pending;
+}
@@ -0,0 +1,148 @@
+// ************************************************
+// StoneLCDSim.h                                 **
+// ***************************************************************************
+/* Header for StoneLCDSim; a simulated Stone HMI Display that can be used in
+ * place of the serial port to run and measure StoneLCDLib code without a
+ * panel. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_SIM_H__
+#define _STONE_LCD_SIM_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Simulated variable (VP) memory, in words. Addresses past it read as 0.
+#ifndef STONE_SIM_VARIABLES
+#define STONE_SIM_VARIABLES             128
+#endif
+
+// Simulated flash database (DBL), in words. Addresses past it read as 0.
+#ifndef STONE_SIM_FLASH_WORDS
+#define STONE_SIM_FLASH_WORDS           256
+#endif
+
+// Time a database operation takes
+#define STONE_SIM_DEFAULT_DBL_US        5000
+
+// Bytes the display can have queued (or on the wire) towards the host
+#ifndef STONE_SIM_REPLY_BUFFER_SIZE
+#define STONE_SIM_REPLY_BUFFER_SIZE     256
+#endif
+
+// Reply frames in flight (each with its own arrival time)
+#define STONE_SIM_MAX_REPLIES           8
+
+// Size of the host UART TX buffer reported by availableForWrite()
+#define STONE_SIM_HOST_TX_BUFFER        64
+
+// Time the display takes to start answering a frame
+#define STONE_SIM_DEFAULT_RESPONSE_US   1000
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+typedef struct {
+  uint32_t hostBytes;      // Bytes sent by the host
+  uint32_t hostFrames;
+  uint32_t displayBytes;   // Bytes sent by the display
+  uint32_t displayFrames;
+  uint32_t wireTimeUs;     // Time both lines were busy, added together
+} StoneLCDSimStats;
+
+typedef struct {
+  unsigned long startUs;   // When the first byte of the reply is complete
+  uint16_t count;
+} StoneLCDSimReply;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                           S t o n e L C D S i m                        ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDSim : public Stream {
+private:
+  uint8_t  cmdFrameLSB, cmdFrameHSB;
+  boolean  useCRC;
+  uint32_t byteTimeUs;
+  uint16_t responseUs;
+  unsigned long hostLineFreeAt;
+  unsigned long displayLineFreeAt;
+
+  // Frame being received from the host
+  uint16_t inCount;
+  uint8_t  inFrame[3 + 255];
+
+  // Bytes on their way to the host
+  uint16_t outHead, outCount;
+  uint8_t  outBuffer[STONE_SIM_REPLY_BUFFER_SIZE];
+  uint8_t  replyHead, replyCount;
+  StoneLCDSimReply replies[STONE_SIM_MAX_REPLIES];
+  uint16_t replyStart;     // outCount when the reply being built was started
+  uint16_t replyCRC;
+  unsigned long lastByteAt;
+
+  uint8_t  registers[256];
+  uint16_t variables[STONE_SIM_VARIABLES];
+  uint16_t flash[STONE_SIM_FLASH_WORDS];
+  uint32_t dblUs;
+  boolean  dblRunning;
+  unsigned long dblDoneAt;
+  StoneLCDSimStats stats;
+
+  void     receiveByte(uint8_t b);
+  void     processFrame();
+  boolean  beginReply(uint8_t cmd, uint8_t len);
+  void     replyByte(uint8_t b);
+  void     endReply(unsigned long readyAt);
+  uint16_t arrivedBytes();
+  void     startDatabaseOp(unsigned long at);
+  void     updateDatabaseOp(unsigned long now);
+
+public:
+  StoneLCDSim(uint32_t baudRate = 115200, uint8_t cmdHi = 0xA5, uint8_t cmdLo = 0x5A, boolean crcMode = false);
+
+  void setBaudRate(uint32_t baudRate);
+  void setResponseTimeUs(uint16_t us);
+  void setDatabaseTimeUs(uint32_t us);
+
+  // Display memory
+  void     setRegister(uint8_t address, uint8_t value);
+  uint8_t  getRegister(uint8_t address);
+  void     setVariable(uint16_t address, uint16_t value);
+  uint16_t getVariable(uint16_t address);
+
+  // Simulates the user changing a control: the variable is updated and
+  // reported to the host, as displays do for auto-upload controls.
+  boolean  touchVariable(uint16_t address, uint16_t value);
+
+  // Simulates the touch panel: posts a touch record (TP_FLAG = 0x5A, then
+  // TP_STATUS and TP_POSITION), for code that samples the touch registers.
+  // Nothing is sent to the host.
+  void     touchPanel(uint8_t status, uint16_t x, uint16_t y);
+
+  // Traffic counters
+  void     getStats(StoneLCDSimStats *dst);
+  void     resetStats();
+
+  // Stream interface
+  int     available();
+  int     read();
+  int     peek();
+  void    flush();
+  size_t  write(uint8_t b);
+  size_t  write(const uint8_t *buffer, size_t size);
+  int     availableForWrite();
+  using Print::write;
+};
+#endif
@@ -0,0 +1,195 @@
+// ************************************************
+// StoneLCDText.cpp                              **
+// ***************************************************************************
+/* Implementation of StoneLCDText; text variables that are only sent as far
+ * as they changed, for Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDText.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            M A C R O S                                 ##
+ *##                                                                        ##
+ *############################################################################*/
+#define tryOrReturnFalse(f)         if(!(f)) return false
+
+#define STONE_TEXT_NO_WORD          0xFF
+
+/*############################################################################
+ *##                                                                        ##
+ *##                          F U N C T I O N S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+// Returns how many bytes of text (len bytes long) fit in maxBytes without
+// splitting a GBK double-byte character (lead bytes are 0x81 - 0xFE).
+uint8_t gbkFit(const char *text, uint8_t len, uint8_t maxBytes){
+  uint8_t i = 0, n;
+
+  while (i < len) {
+    n = ((uint8_t)text[i] >= 0x81 && i + 1 < len) ? 2 : 1;
+    if (i + n > maxBytes) break;
+    i += n;
+  }
+  return i;
+}
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D T e x t                        ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDText::StoneLCDText(StoneLCD *display) {
+  this->lcd = display;
+  this->varCount = 0;
+  this->used = 0;
+  this->padding = 0;
+  this->encoding = STONE_TEXT_GBK;
+  this->bytesSent = 0;
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+StoneLCDTextVar *StoneLCDText::findVariable(uint16_t address) {
+  uint8_t i;
+
+  for (i = 0; i < this->varCount; i++) {
+    if (this->vars[i].address == address) return &this->vars[i];
+  }
+  return NULL;
+}
+
+uint8_t StoneLCDText::encodeByte(uint8_t b) {
+  if (this->encoding == STONE_TEXT_ASCII && b > 0x7F) return '?';
+  return b;
+}
+
+// Sends words first - last of the copy kept for a variable
+boolean StoneLCDText::sendWords(StoneLCDTextVar *var, uint8_t first, uint8_t last) {
+  uint8_t bytes = (last - first + 1) << 1;
+
+  tryOrReturnFalse (this->lcd->writeVariableBytes(var->address + first, &this->shadow[var->offset + (first << 1)], bytes));
+  this->bytesSent += bytes;
+  return true;
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+// By default texts end with STONE_TEXT_TERMINATOR. With a padding character
+// (e.g. ' ') the whole field is filled with it after the text instead, for
+// text controls that always show their full length.
+void StoneLCDText::setPadding(uint8_t pad) {
+  this->padding = pad;
+  this->invalidate();
+}
+
+// STONE_TEXT_GBK (default) or STONE_TEXT_ASCII
+void StoneLCDText::setEncoding(uint8_t enc) {
+  this->encoding = enc;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+// Text bytes sent so far, to compare with what full rewrites would take
+uint16_t StoneLCDText::getBytesSent() {
+  return this->bytesSent;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// size is the number of bytes reserved for the text on the display (rounded
+// down to whole words). It's taken from the STONE_TEXT_BUFFER_SIZE bytes
+// shared by all the variables.
+boolean StoneLCDText::addVariable(uint16_t address, uint8_t size) {
+  StoneLCDTextVar *var;
+
+  size &= ~1;
+  if (size == 0 || this->varCount >= STONE_TEXT_MAX_VARS || this->findVariable(address) != NULL) return false;
+  if (size > STONE_TEXT_BUFFER_SIZE - this->used) return false;
+
+  var = &this->vars[this->varCount++];
+  var->address = address;
+  var->offset = this->used;
+  var->size = size;
+  var->knownWords = 0;
+  this->used += size;
+  return true;
+}
+
+boolean StoneLCDText::setText(uint16_t address, const char *text) {
+  size_t len = (text == NULL) ? 0 : strlen(text);
+  return this->setText(address, text, len > 255 ? 255 : len);
+}
+
+// Compares the new text (terminated or padded) with what the display has,
+// and sends only the words that changed. Changed words close to each other
+// go in the same frame. Texts longer than the variable are cut.
+boolean StoneLCDText::setText(uint16_t address, const char *text, uint8_t len) {
+  StoneLCDTextVar *var = this->findVariable(address);
+  uint8_t *copy;
+  uint8_t i, b, end, w, words, first = STONE_TEXT_NO_WORD, last = 0;
+  boolean changed, ok = true;
+
+  if (var == NULL || (text == NULL && len > 0)) return false;
+  copy = &this->shadow[var->offset];
+  if (this->encoding == STONE_TEXT_GBK) {
+    len = gbkFit(text, len, var->size);
+  } else if (len > var->size) {
+    len = var->size;
+  }
+
+  // The terminator goes up to the end of the word after the text
+  end = (this->padding != 0 || len >= var->size) ? var->size : (len + 2) & ~1;
+  if (end > var->size) end = var->size;
+  words = end >> 1;
+
+  for (w = 0; w < words; w++) {
+    changed = (w >= var->knownWords);
+    for (i = w << 1; i < (w << 1) + 2; i++) {
+      b = (i < len) ? this->encodeByte(text[i]) : (this->padding != 0 ? this->padding : STONE_TEXT_TERMINATOR);
+      if (copy[i] != b) {
+        copy[i] = b;
+        changed = true;
+      }
+    }
+    if (!changed) continue;
+    if (first != STONE_TEXT_NO_WORD && w - last - 1 > STONE_TEXT_MERGE_GAP) {
+      ok = this->sendWords(var, first, last) && ok;
+      first = STONE_TEXT_NO_WORD;
+    }
+    if (first == STONE_TEXT_NO_WORD) first = w;
+    last = w;
+  }
+  if (first != STONE_TEXT_NO_WORD) ok = this->sendWords(var, first, last) && ok;
+
+  // After a failure nothing is taken for granted, and the next text is sent whole
+  if (!ok) {
+    var->knownWords = 0;
+  } else if (words > var->knownWords) {
+    var->knownWords = words;
+  }
+  return ok;
+}
+
+// Makes the next setText() send the whole text, e.g. after the display was
+// reset or its page reloaded the variables.
+void StoneLCDText::invalidate() {
+  uint8_t i;
+  for (i = 0; i < this->varCount; i++) this->vars[i].knownWords = 0;
+}
+
+void StoneLCDText::invalidate(uint16_t address) {
+  StoneLCDTextVar *var = this->findVariable(address);
+  if (var != NULL) var->knownWords = 0;
+}
@@ -0,0 +1,94 @@
+// ************************************************
+// StoneLCDText.h                                **
+// ***************************************************************************
+/* Header for StoneLCDText; text variables that are only sent as far as they
+ * changed, for Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_TEXT_H__
+#define _STONE_LCD_TEXT_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Text variables a StoneLCDText object can track
+#ifndef STONE_TEXT_MAX_VARS
+#define STONE_TEXT_MAX_VARS             4
+#endif
+
+// Bytes kept (in total) as a copy of what each text variable has on the
+// display
+#ifndef STONE_TEXT_BUFFER_SIZE
+#define STONE_TEXT_BUFFER_SIZE          64
+#endif
+
+// Written after the text, up to the end of the next word, unless padding
+// is used (see setPadding)
+#ifndef STONE_TEXT_TERMINATOR
+#define STONE_TEXT_TERMINATOR           0x00
+#endif
+
+// Unchanged words between two changed ones that are sent anyway, instead of
+// starting a new frame (which costs about as much: header, cmd and address)
+#define STONE_TEXT_MERGE_GAP            3
+
+// --- Encodings -----------------------------------------------
+#define STONE_TEXT_GBK                  0  // Bytes are sent as they are (ASCII is a subset)
+#define STONE_TEXT_ASCII                1  // Bytes over 0x7F are replaced with '?'
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+typedef struct {
+  uint16_t address;
+  uint8_t  offset;         // Of its copy in the text buffer
+  uint8_t  size;           // Bytes reserved for the text on the display
+  uint8_t  knownWords;     // Leading words known to match the display
+} StoneLCDTextVar;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D T e x t                        ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDText {
+private:
+  StoneLCD *lcd;
+  uint8_t  varCount;
+  uint8_t  used;           // Bytes of the text buffer taken
+  uint8_t  padding;
+  uint8_t  encoding;
+  uint16_t bytesSent;
+  StoneLCDTextVar vars[STONE_TEXT_MAX_VARS];
+  uint8_t  shadow[STONE_TEXT_BUFFER_SIZE];
+
+  StoneLCDTextVar *findVariable(uint16_t address);
+  uint8_t  encodeByte(uint8_t b);
+  boolean  sendWords(StoneLCDTextVar *var, uint8_t first, uint8_t last);
+
+public:
+  StoneLCDText(StoneLCD *display);
+
+  boolean addVariable(uint16_t address, uint8_t size);
+  void    setPadding(uint8_t pad);
+  void    setEncoding(uint8_t enc);
+
+  boolean setText(uint16_t address, const char *text);
+  boolean setText(uint16_t address, const char *text, uint8_t len);
+  void    invalidate();
+  void    invalidate(uint16_t address);
+  uint16_t getBytesSent();
+};
+
+uint8_t gbkFit(const char *text, uint8_t len, uint8_t maxBytes);
+#endif
@@ -0,0 +1,188 @@
+// ************************************************
+// StoneLCDTouch.cpp                             **
+// ***************************************************************************
+/* Implementation of StoneLCDTouch; non-blocking touch panel sampling and
+ * gesture detection for Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDTouch.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            M A C R O S                                 ##
+ *##                                                                        ##
+ *############################################################################*/
+#define wordFromBytes(h,l)          ((h<<8) | (l))
+#define clampSpeed(v)               ((v) > 32767 ? 32767 : ((v) < -32767 ? -32767 : (v)))
+
+#define STONE_TP_STATUS_UNKNOWN     0xFF
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D T o u c h                      ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDTouch::StoneLCDTouch(StoneLCD *display) {
+  this->lcd = display;
+  this->intervalMs = STONE_TOUCH_DEFAULT_INTERVAL;
+  this->dragThreshold = STONE_TOUCH_DEFAULT_DRAG;
+  this->lastPollAt = 0;
+  this->lastSampleAt = 0;
+  this->readHandle = -1;
+  this->clearPending = false;
+  this->lastStatus = STONE_TP_STATUS_UNKNOWN;
+  this->handler = NULL;
+  memset(&this->sample, 0, sizeof(this->sample));
+  memset(&this->state, 0, sizeof(this->state));
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+void StoneLCDTouch::decodeSample() {
+  this->sample.updated = (this->regs[0] == 0x5A);
+  this->sample.status = this->regs[1];
+  this->sample.x = wordFromBytes(this->regs[2], this->regs[3]);
+  this->sample.y = wordFromBytes(this->regs[4], this->regs[5]);
+  this->sample.at = millis();
+}
+
+// Turns the sample into press/drag/release gestures. Velocity is smoothed
+// over the last samples so a single jittery reading doesn't dominate it.
+void StoneLCDTouch::trackGesture() {
+  StoneLCDTouchState *s = &this->state;
+  unsigned long dt;
+  int32_t vx, vy;
+  uint16_t dx, dy;
+
+  // A new press while we still think the panel is pressed means the release
+  // was missed (its flag was overwritten before we read it).
+  if (s->pressed && this->sample.status == STONE_TP_STATUS_PRESS) {
+    s->pressed = false;
+    this->notify(STONE_TOUCH_RELEASE);
+  }
+
+  if (!s->pressed) {
+    if (this->sample.status == STONE_TP_STATUS_RELEASE) return;
+    s->pressed = true;
+    s->dragging = false;
+    s->x = s->startX = this->sample.x;
+    s->y = s->startY = this->sample.y;
+    s->vx = s->vy = 0;
+    s->pressedAt = this->sample.at;
+    this->lastSampleAt = this->sample.at;
+    this->notify(STONE_TOUCH_PRESS);
+    return;
+  }
+
+  if (this->sample.x != s->x || this->sample.y != s->y) {
+    dt = this->sample.at - this->lastSampleAt;
+    if (dt > 0) {
+      vx = ((int32_t)this->sample.x - s->x) * 1000 / (int32_t)dt;
+      vy = ((int32_t)this->sample.y - s->y) * 1000 / (int32_t)dt;
+      s->vx = (int16_t)((clampSpeed(vx) + s->vx) / 2);
+      s->vy = (int16_t)((clampSpeed(vy) + s->vy) / 2);
+    }
+    s->x = this->sample.x;
+    s->y = this->sample.y;
+  }
+  this->lastSampleAt = this->sample.at;
+
+  if (this->sample.status == STONE_TP_STATUS_RELEASE) {
+    s->pressed = false;
+    this->notify(STONE_TOUCH_RELEASE);
+    s->dragging = false;
+    return;
+  }
+
+  dx = s->x > s->startX ? s->x - s->startX : s->startX - s->x;
+  dy = s->y > s->startY ? s->y - s->startY : s->startY - s->y;
+  if (!s->dragging && (dx >= this->dragThreshold || dy >= this->dragThreshold)) s->dragging = true;
+  if (s->dragging) this->notify(STONE_TOUCH_DRAG);
+}
+
+void StoneLCDTouch::notify(uint8_t gesture) {
+  if (this->handler != NULL) this->handler(gesture, &this->state);
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+// Time between touch register reads
+void StoneLCDTouch::setPollIntervalMs(uint16_t ms) {
+  this->intervalMs = ms;
+}
+
+void StoneLCDTouch::setDragThreshold(uint8_t pixels) {
+  this->dragThreshold = pixels;
+}
+
+void StoneLCDTouch::onGesture(StoneLCDTouchHandler callback) {
+  this->handler = callback;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+boolean StoneLCDTouch::isPressed() {
+  return this->state.pressed;
+}
+
+// Last sample read, whether it had new data or not
+void StoneLCDTouch::getSample(StoneLCDTouchSample *dst) {
+  if (dst != NULL) *dst = this->sample;
+}
+
+void StoneLCDTouch::getState(StoneLCDTouchState *dst) {
+  if (dst != NULL) *dst = this->state;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// Call this often (e.g. from loop()). It never waits for the display: every
+// poll interval it requests the flag, status and position registers in a
+// single read, and picks up the reply on a later call. Returns true when a
+// sample with new touch data was decoded.
+boolean StoneLCDTouch::update() {
+  uint8_t status;
+  boolean changed;
+  unsigned long now = millis();
+
+  if (this->readHandle >= 0) {
+    status = this->lcd->getReadStatus(this->readHandle);
+    if (status == STONE_READ_PENDING) return false;
+    this->readHandle = -1;
+    if (status != STONE_READ_DONE) return false;
+
+    this->decodeSample();
+    // A status change counts even without the flag, in case the flag of a
+    // record (usually the release) was lost
+    changed = (this->lastStatus != STONE_TP_STATUS_UNKNOWN && this->sample.status != this->lastStatus);
+    this->lastStatus = this->sample.status;
+    if (!this->sample.updated && !changed) return false;
+    // Clear the flag right away, so the display can post the next record.
+    // If that fails it's tried again before the next read.
+    if (this->sample.updated) {
+      this->clearPending = !this->lcd->writeRegisterByte(STONE_REG_TP_FLAG, 0);
+    }
+    this->trackGesture();
+    return true;
+  }
+
+  if (now - this->lastPollAt < this->intervalMs) return false;
+  this->lastPollAt = now;
+  if (this->clearPending) {
+    if (!this->lcd->writeRegisterByte(STONE_REG_TP_FLAG, 0)) return false;
+    this->clearPending = false;
+  }
+  this->readHandle = this->lcd->requestRegisterRead(STONE_REG_TP_FLAG, this->regs, STONE_TOUCH_REG_BLOCK_SIZE);
+  return false;
+}
@@ -0,0 +1,100 @@
+// ************************************************
+// StoneLCDTouch.h                               **
+// ***************************************************************************
+/* Header for StoneLCDTouch; non-blocking touch panel sampling and gesture
+ * detection for Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_TOUCH_H__
+#define _STONE_LCD_TOUCH_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+#define STONE_TOUCH_DEFAULT_INTERVAL    20  // ms
+#define STONE_TOUCH_DEFAULT_DRAG        4   // Pixels moved before a press becomes a drag
+
+// TP_FLAG (1) + TP_STATUS (1) + TP_POSITION (4), read in one go
+#define STONE_TOUCH_REG_BLOCK_SIZE      6
+
+// --- TP_STATUS values ----------------------------------------
+#define STONE_TP_STATUS_PRESS           0x01
+#define STONE_TP_STATUS_RELEASE         0x02
+#define STONE_TP_STATUS_HOLD            0x03
+
+// --- Gestures ------------------------------------------------
+#define STONE_TOUCH_PRESS               1
+#define STONE_TOUCH_DRAG                2
+#define STONE_TOUCH_RELEASE             3
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+// A decoded TP_FLAG..TP_POSITION register block
+typedef struct {
+  uint8_t  updated;        // TP_FLAG was 0x5A (new data)
+  uint8_t  status;         // STONE_TP_STATUS_xxx
+  uint16_t x;
+  uint16_t y;
+  unsigned long at;        // millis() when the reply arrived
+} StoneLCDTouchSample;
+
+typedef struct {
+  boolean  pressed;
+  boolean  dragging;
+  uint16_t x, y;
+  uint16_t startX, startY; // Where the press started
+  int16_t  vx, vy;         // Pixels per second. On release, the speed it was let go at.
+  unsigned long pressedAt;
+} StoneLCDTouchState;
+
+typedef void (*StoneLCDTouchHandler)(uint8_t gesture, StoneLCDTouchState *touch);
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D T o u c h                      ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDTouch {
+private:
+  StoneLCD *lcd;
+  uint16_t intervalMs;
+  uint8_t  dragThreshold;
+  unsigned long lastPollAt;      // When the last read was requested
+  unsigned long lastSampleAt;    // Previous sample of the current press
+  int8_t   readHandle;
+  boolean  clearPending;          // Clearing the flag failed; retried before the next read
+  uint8_t  lastStatus;            // TP_STATUS of the previous sample
+  uint8_t  regs[STONE_TOUCH_REG_BLOCK_SIZE];
+  StoneLCDTouchSample sample;
+  StoneLCDTouchState  state;
+  StoneLCDTouchHandler handler;
+
+  void     decodeSample();
+  void     trackGesture();
+  void     notify(uint8_t gesture);
+
+public:
+  StoneLCDTouch(StoneLCD *display);
+
+  void setPollIntervalMs(uint16_t ms);
+  void setDragThreshold(uint8_t pixels);
+  void onGesture(StoneLCDTouchHandler callback);
+
+  boolean update();
+
+  boolean isPressed();
+  void    getSample(StoneLCDTouchSample *dst);
+  void    getState(StoneLCDTouchState *dst);
+};
+#endif
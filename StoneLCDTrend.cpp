@@ -0,0 +1,207 @@
+// ************************************************
+// StoneLCDTrend.cpp                             **
+// ***************************************************************************
+/* Implementation of StoneLCDTrend; buffered streaming of samples to the
+ * curve (trend) buffers of Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDTrend.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            M A C R O S                                 ##
+ *##                                                                        ##
+ *############################################################################*/
+#define tryOrReturnFalse(f)         if(!(f)) return false
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D T r e n d                      ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+// channels is a bit mask of the curve channels (0-7) this object streams to.
+// The sample buffer is split evenly between them.
+StoneLCDTrend::StoneLCDTrend(StoneLCD *display, uint8_t channels) {
+  uint8_t ch;
+  uint16_t perChannel;
+
+  this->lcd = display;
+  this->channelMask = channels;
+  this->channelCount = 0;
+  for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) {
+    this->head[ch] = 0;
+    this->count[ch] = 0;
+    this->channelSlot[ch] = this->channelCount;
+    if (channels & (1 << ch)) this->channelCount++;
+  }
+  perChannel = this->channelCount > 0 ? STONE_TREND_BUFFER_SIZE / this->channelCount : 0;
+  this->capacity = perChannel > 255 ? 255 : perChannel;
+  this->flushThreshold = this->capacity;
+  this->flushIntervalMs = STONE_TREND_DEFAULT_INTERVAL;
+  this->oldestSampleAt = 0;
+  this->pendingSamples = 0;
+  this->droppedSamples = 0;
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+// Sends "groups" samples of every channel in mask as a single frame. They
+// are only taken out of the buffer once the frame went out.
+boolean StoneLCDTrend::sendFrame(uint8_t mask, uint8_t groups) {
+  uint8_t g, ch, words = 0;
+  uint8_t head[STONE_CURVE_CHANNELS];
+  uint16_t *ring;
+
+  for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) {
+    head[ch] = this->head[ch];
+    if (mask & (1 << ch)) words += groups;
+  }
+  tryOrReturnFalse (this->lcd->startFrame(STONE_CMD_CURVE_BUFFER_WRITE, 2 + (words<<1))); // cmd (1) + channel mask (1) + data size
+  tryOrReturnFalse (this->lcd->addFrameByte(mask));
+  for (g = 0; g < groups; g++) {
+    for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) {
+      if (!(mask & (1 << ch))) continue;
+      ring = &this->samples[this->channelSlot[ch] * this->capacity];
+      tryOrReturnFalse (this->lcd->addFrameWord(ring[head[ch]]));
+      head[ch] = (head[ch] + 1) % this->capacity;
+    }
+  }
+  tryOrReturnFalse (this->lcd->finishFrame());
+
+  for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) {
+    if (!(mask & (1 << ch))) continue;
+    this->head[ch] = head[ch];
+    this->count[ch] -= groups;
+    this->pendingSamples -= groups;
+  }
+  return true;
+}
+
+void StoneLCDTrend::dropChannel(uint8_t channel) {
+  this->pendingSamples -= this->count[channel];
+  this->count[channel] = 0;
+  this->head[channel] = 0;
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+// Buffered samples are sent as soon as one channel has this many
+void StoneLCDTrend::setFlushThreshold(uint8_t samplesPerChannel) {
+  if (samplesPerChannel == 0 || samplesPerChannel > this->capacity) samplesPerChannel = this->capacity;
+  this->flushThreshold = samplesPerChannel;
+}
+
+// ... or when the oldest buffered sample is this old (checked by update())
+void StoneLCDTrend::setFlushIntervalMs(uint16_t ms) {
+  this->flushIntervalMs = ms;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+uint16_t StoneLCDTrend::getPendingSamples() {
+  return this->pendingSamples;
+}
+
+// Samples lost because the buffer was full and couldn't be flushed
+uint16_t StoneLCDTrend::getDroppedSamples() {
+  return this->droppedSamples;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+boolean StoneLCDTrend::addSample(uint8_t channel, uint16_t value) {
+  uint16_t *ring;
+
+  if (channel >= STONE_CURVE_CHANNELS || !(this->channelMask & (1 << channel))) return false;
+
+  // A full channel forces a flush. If even that fails, the oldest sample goes.
+  if (this->count[channel] >= this->capacity) this->flush();
+  if (this->count[channel] >= this->capacity) {
+    this->head[channel] = (this->head[channel] + 1) % this->capacity;
+    this->count[channel]--;
+    this->pendingSamples--;
+    this->droppedSamples++;
+  }
+
+  ring = &this->samples[this->channelSlot[channel] * this->capacity];
+  ring[(this->head[channel] + this->count[channel]) % this->capacity] = value;
+  this->count[channel]++;
+  if (this->pendingSamples++ == 0) this->oldestSampleAt = millis();
+
+  if (this->count[channel] >= this->flushThreshold) return this->flush();
+  return true;
+}
+
+// Adds one sample to every channel in use. values holds them in channel
+// order, lowest channel first.
+boolean StoneLCDTrend::addSamples(uint16_t *values) {
+  uint8_t ch, i = 0;
+  uint8_t threshold = this->flushThreshold;
+  boolean ok = true;
+
+  // Hold the threshold flush until the whole group is in, so it isn't split
+  this->flushThreshold = this->capacity;
+  for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) {
+    if (this->channelMask & (1 << ch)) ok = this->addSample(ch, values[i++]) && ok;
+  }
+  this->flushThreshold = threshold;
+  for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) {
+    if (this->count[ch] >= this->flushThreshold) return this->flush() && ok;
+  }
+  return ok;
+}
+
+// Call this often (e.g. from loop()) so buffered samples don't wait longer
+// than the flush interval.
+boolean StoneLCDTrend::update() {
+  if (this->pendingSamples == 0) return true;
+  if (millis() - this->oldestSampleAt < this->flushIntervalMs) return true;
+  return this->flush();
+}
+
+// Sends everything that is buffered in as few frames as possible. Samples of
+// channels that have the same amount pending go together in one frame; the
+// surplus of busier channels follows in frames of their own.
+boolean StoneLCDTrend::flush() {
+  uint8_t ch, mask, channels, groups, maxGroups;
+
+  while (this->pendingSamples > 0) {
+    mask = 0;
+    channels = 0;
+    groups = 255;
+    for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) {
+      if (this->count[ch] == 0) continue;
+      mask |= (1 << ch);
+      channels++;
+      if (this->count[ch] < groups) groups = this->count[ch];
+    }
+    maxGroups = STONE_CURVE_MAX_WORDS / channels;
+    if (groups > maxGroups) groups = maxGroups;
+    tryOrReturnFalse (this->sendFrame(mask, groups));
+  }
+  return true;
+}
+
+boolean StoneLCDTrend::clearChannel(uint8_t channel) {
+  if (channel >= STONE_CURVE_CHANNELS) return false;
+  this->dropChannel(channel);
+  return this->lcd->clearCurveBuffer(channel);
+}
+
+// Clears all 8 curve buffers on the display, not only the ones in use here
+boolean StoneLCDTrend::clearAll() {
+  uint8_t ch;
+  for (ch = 0; ch < STONE_CURVE_CHANNELS; ch++) this->dropChannel(ch);
+  return this->lcd->clearAllCurveBuffers();
+}
@@ -0,0 +1,70 @@
+// ************************************************
+// StoneLCDTrend.h                               **
+// ***************************************************************************
+/* Header for StoneLCDTrend; buffered streaming of samples to the curve
+ * (trend) buffers of Stone HMI Displays. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_TREND_H__
+#define _STONE_LCD_TREND_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Samples buffered in total, split evenly between the channels in use
+#ifndef STONE_TREND_BUFFER_SIZE
+#define STONE_TREND_BUFFER_SIZE         64
+#endif
+
+#define STONE_TREND_DEFAULT_INTERVAL    50  // ms
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D T r e n d                      ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDTrend {
+private:
+  StoneLCD *lcd;
+  uint8_t  channelMask;
+  uint8_t  channelCount;
+  uint8_t  channelSlot[STONE_CURVE_CHANNELS];   // Channel -> buffer slot
+  uint8_t  capacity;                            // Samples per channel
+  uint8_t  head[STONE_CURVE_CHANNELS];
+  uint8_t  count[STONE_CURVE_CHANNELS];
+  uint16_t samples[STONE_TREND_BUFFER_SIZE];
+  uint8_t  flushThreshold;
+  uint16_t flushIntervalMs;
+  unsigned long oldestSampleAt;
+  uint16_t pendingSamples;
+  uint16_t droppedSamples;
+
+  boolean  sendFrame(uint8_t mask, uint8_t groups);
+  void     dropChannel(uint8_t channel);
+
+public:
+  StoneLCDTrend(StoneLCD *display, uint8_t channels);
+
+  void setFlushThreshold(uint8_t samplesPerChannel);
+  void setFlushIntervalMs(uint16_t ms);
+
+  boolean addSample(uint8_t channel, uint16_t value);
+  boolean addSamples(uint16_t *values);
+  uint16_t getPendingSamples();
+  uint16_t getDroppedSamples();
+
+  boolean update();
+  boolean flush();
+
+  boolean clearChannel(uint8_t channel);
+  boolean clearAll();
+};
+#endif
@@ -0,0 +1,191 @@
+// ************************************************
+// StoneLCDVars.h                                **
+// ***************************************************************************
+/* Typed variable (VP) declarations and variable maps for StoneLCDLib.
+ * Addresses, widths and the contiguous runs a group of variables is sent in
+ * are all worked out by the compiler. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_VARS_H__
+#define _STONE_LCD_VARS_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                      V A L U E   E N C O D I N G                       ##
+ *##                                                                        ##
+ *############################################################################*/
+// Converts values to and from the words they take on the display. 32-bit
+// values take two variables, high word first.
+template <uint8_t Words> struct StoneVarCodec;
+
+template <> struct StoneVarCodec<1> {
+  template <typename T> static void encode(T value, uint16_t *dst) {
+    dst[0] = (uint16_t)value;
+  }
+  template <typename T> static T decode(const uint16_t *src) {
+    return (T)src[0];
+  }
+};
+
+template <> struct StoneVarCodec<2> {
+  template <typename T> static void encode(T value, uint16_t *dst) {
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    dst[0] = (uint16_t)(raw >> 16);
+    dst[1] = (uint16_t)(raw & 0xffff);
+  }
+  template <typename T> static T decode(const uint16_t *src) {
+    T value;
+    uint32_t raw = ((uint32_t)src[0] << 16) | src[1];
+    memcpy(&value, &raw, sizeof(value));
+    return value;
+  }
+};
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            S t o n e V a r                             ##
+ *##                                                                        ##
+ *############################################################################*/
+// A display variable with a fixed address and type, e.g.:
+//   typedef StoneVar<0x0010, int16_t>  Temperature;
+//   Temperature::write(&myLCD, -5);
+template <uint16_t Addr, typename T = uint16_t>
+struct StoneVar {
+  typedef T type;
+  static const uint16_t address = Addr;
+  static const uint8_t  words = (sizeof(T) + 1) >> 1;
+  static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4, "StoneVar: types must be 1, 2 or 4 bytes wide");
+
+  static boolean write(StoneLCD *lcd, T value) {
+    uint16_t data[words];
+    StoneVarCodec<words>::encode(value, data);
+    return lcd->writeVariable(Addr, data, words);
+  }
+
+  // Returns 0 if the read fails
+  static T read(StoneLCD *lcd) {
+    uint16_t data[words];
+    if (!lcd->readVariable(Addr, data, words)) return (T)0;
+    return StoneVarCodec<words>::template decode<T>(data);
+  }
+};
+
+/*############################################################################
+ *##                                                                        ##
+ *##                      M A P   M E T A F U N C T I O N S                 ##
+ *##                                                                        ##
+ *############################################################################*/
+// First variable of a list
+template <class V, class... Rest> struct StoneVarFirst {
+  static const uint16_t address = V::address;
+};
+
+// Total words taken by a list of variables
+template <class... Vs> struct StoneVarWords;
+template <> struct StoneVarWords<> {
+  static const uint16_t value = 0;
+};
+template <class V, class... Rest> struct StoneVarWords<V, Rest...> {
+  static const uint16_t value = V::words + StoneVarWords<Rest...>::value;
+};
+
+// Position (in words) of variable V in a list
+template <class V, class... Vs> struct StoneVarOffset;
+template <class V, class... Rest> struct StoneVarOffset<V, V, Rest...> {
+  static const uint16_t value = 0;
+};
+template <class V, class A, class... Rest> struct StoneVarOffset<V, A, Rest...> {
+  static const uint16_t value = A::words + StoneVarOffset<V, Rest...>::value;
+};
+
+// Number of contiguous runs in a list. Also checks that the list is
+// in address order and that no two variables overlap.
+template <class... Vs> struct StoneVarRuns;
+template <class V> struct StoneVarRuns<V> {
+  static const uint8_t value = 1;
+};
+template <class A, class B, class... Rest> struct StoneVarRuns<A, B, Rest...> {
+  static_assert(B::address >= A::address + A::words, "StoneVarMap: variables must be listed in address order, without overlapping");
+  static const uint8_t value = StoneVarRuns<B, Rest...>::value + (B::address != A::address + A::words ? 1 : 0);
+};
+
+// Reads or writes a list one contiguous run at a time. RunAddr and RunOffset
+// are the address and position (in data) where the current run starts, and
+// Offset is the position of the first variable in the list.
+template <uint16_t RunAddr, uint16_t RunOffset, uint16_t Offset, class... Vs> struct StoneVarTransfer;
+
+template <uint16_t RunAddr, uint16_t RunOffset, uint16_t Offset, class V>
+struct StoneVarTransfer<RunAddr, RunOffset, Offset, V> {
+  static boolean run(StoneLCD *lcd, uint16_t *data, boolean isRead) {
+    if (isRead) return lcd->readVariable(RunAddr, &data[RunOffset], Offset + V::words - RunOffset);
+    return lcd->writeVariable(RunAddr, &data[RunOffset], Offset + V::words - RunOffset);
+  }
+};
+
+template <uint16_t RunAddr, uint16_t RunOffset, uint16_t Offset, class A, class B, class... Rest>
+struct StoneVarTransfer<RunAddr, RunOffset, Offset, A, B, Rest...> {
+  static const boolean runEnds = (B::address != A::address + A::words);
+
+  static boolean run(StoneLCD *lcd, uint16_t *data, boolean isRead) {
+    if (runEnds && !StoneVarTransfer<RunAddr, RunOffset, Offset, A>::run(lcd, data, isRead)) return false;
+    return StoneVarTransfer<runEnds ? B::address : RunAddr,
+                            runEnds ? Offset + A::words : RunOffset,
+                            Offset + A::words, B, Rest...>::run(lcd, data, isRead);
+  }
+};
+
+/*############################################################################
+ *##                                                                        ##
+ *##                          S t o n e V a r M a p                         ##
+ *##                                                                        ##
+ *############################################################################*/
+// A group of variables, listed in address order, whose values are kept here
+// and sent (or read) together with the fewest frames possible:
+//   typedef StoneVar<0x0006> TextWhite;
+//   typedef StoneVar<0x0007> TextRed;
+//   typedef StoneVar<0x0010, uint32_t> Counter;
+//   StoneVarMap<TextWhite, TextRed, Counter> ui;  // 2 runs, so 2 frames
+//
+//   ui.set<TextRed>(100);
+//   ui.write(&myLCD);
+template <class... Vs>
+class StoneVarMap {
+private:
+  uint16_t data[StoneVarWords<Vs...>::value];
+
+public:
+  static const uint16_t words  = StoneVarWords<Vs...>::value;
+  // One frame per run at least; runs longer than STONE_VAR_WRITE_MAX_WORDS
+  // (writes) or STONE_VAR_READ_MAX_WORDS (reads) are split into more.
+  static const uint8_t  runs   = StoneVarRuns<Vs...>::value;
+
+  StoneVarMap() {
+    memset(this->data, 0, sizeof(this->data));
+  }
+
+  template <class V> void set(typename V::type value) {
+    StoneVarCodec<V::words>::encode(value, &this->data[StoneVarOffset<V, Vs...>::value]);
+  }
+
+  template <class V> typename V::type get() {
+    return StoneVarCodec<V::words>::template decode<typename V::type>(&this->data[StoneVarOffset<V, Vs...>::value]);
+  }
+
+  // Sends every variable of the map, one run at a time
+  boolean write(StoneLCD *lcd) {
+    return StoneVarTransfer<StoneVarFirst<Vs...>::address, 0, 0, Vs...>::run(lcd, this->data, false);
+  }
+
+  // Reads every variable of the map from the display
+  boolean read(StoneLCD *lcd) {
+    return StoneVarTransfer<StoneVarFirst<Vs...>::address, 0, 0, Vs...>::run(lcd, this->data, true);
+  }
+};
+#endif
@@ -0,0 +1,245 @@
+// ************************************************
+// StoneLCDWatch.cpp                             **
+// ***************************************************************************
+/* Implementation of StoneLCDWatch; polls variables of a Stone HMI Display
+ * that change without sending events, merging them into as few reads as
+ * possible and reporting only the values that changed. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include "StoneLCDWatch.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D W a t c h                      ##
+ *##                                                                        ##
+ *############################################################################*/
+
+// ****************************************************
+// ** Constructor
+// ****************************************************
+StoneLCDWatch::StoneLCDWatch(StoneLCD *display) {
+  this->lcd = display;
+  this->entryCount = 0;
+  this->used = 0;
+  this->gapMs = STONE_WATCH_DEFAULT_GAP;
+  this->readHandle = -1;
+  this->readAddress = 0;
+  this->readCount = 0;
+  this->lastReadAt = 0;
+  this->readsDone = 0;
+}
+
+// ****************************************************
+// ** Private Methods
+// ****************************************************
+// Entry whose range includes address
+StoneLCDWatchEntry *StoneLCDWatch::findEntry(uint16_t address) {
+  uint8_t i;
+
+  for (i = 0; i < this->entryCount; i++) {
+    if (address >= this->entries[i].address && (uint32_t)address < (uint32_t)this->entries[i].address + this->entries[i].count) {
+      return &this->entries[i];
+    }
+  }
+  return NULL;
+}
+
+StoneLCDWatchEntry *StoneLCDWatch::mostOverdue(unsigned long now) {
+  StoneLCDWatchEntry *best = NULL;
+  uint8_t i;
+
+  for (i = 0; i < this->entryCount; i++) {
+    if ((long)(now - this->entries[i].dueAt) < 0) continue;
+    if (best == NULL || (long)(best->dueAt - this->entries[i].dueAt) > 0) best = &this->entries[i];
+  }
+  return best;
+}
+
+// Starts with the entry that has waited the longest, and adds every other
+// due entry that fits in the same read (close enough, and within
+// STONE_VAR_READ_MAX_WORDS). Entries that aren't due but end up inside the
+// range are read too, since that costs nothing.
+boolean StoneLCDWatch::planRead(unsigned long now) {
+  StoneLCDWatchEntry *seed = this->mostOverdue(now);
+  StoneLCDWatchEntry *e;
+  uint32_t lo, hi, eLo, eHi;
+  uint8_t i;
+  boolean grown = true;
+
+  if (seed == NULL) return false;
+  seed->reading = true;
+  lo = seed->address;
+  hi = lo + seed->count - 1;
+
+  while (grown) {
+    grown = false;
+    for (i = 0; i < this->entryCount; i++) {
+      e = &this->entries[i];
+      if (e->reading) continue;
+      eLo = e->address;
+      eHi = eLo + e->count - 1;
+      if (eLo >= lo && eHi <= hi) {
+        e->reading = true;
+        continue;
+      }
+      if ((long)(now - e->dueAt) < 0) continue;
+      if (eLo > hi && eLo - hi - 1 > STONE_WATCH_MERGE_GAP) continue;
+      if (eHi < lo && lo - eHi - 1 > STONE_WATCH_MERGE_GAP) continue;
+      if ((eHi > hi ? eHi : hi) - (eLo < lo ? eLo : lo) + 1 > STONE_VAR_READ_MAX_WORDS) continue;
+      if (eLo < lo) lo = eLo;
+      if (eHi > hi) hi = eHi;
+      e->reading = true;
+      grown = true;
+    }
+  }
+
+  this->readAddress = lo;
+  this->readCount = hi - lo + 1;
+  this->readHandle = this->lcd->requestVariableRead(this->readAddress, this->readBuffer, this->readCount);
+  if (this->readHandle >= 0) return true;
+
+  // No free slot (or the link failed): try again after the gap
+  for (i = 0; i < this->entryCount; i++) this->entries[i].reading = false;
+  this->lastReadAt = now;
+  return false;
+}
+
+// Takes the values of the finished read, calling the handlers of the words
+// that changed. Returns true if any did.
+boolean StoneLCDWatch::applyRead(unsigned long now) {
+  StoneLCDWatchEntry *e;
+  uint16_t value;
+  uint8_t i, w;
+  boolean changed = false;
+
+  for (i = 0; i < this->entryCount; i++) {
+    e = &this->entries[i];
+    if (!e->reading) continue;
+    e->reading = false;
+
+    // Keep the entry on its own cadence unless it fell a whole period behind
+    if ((long)(now - e->dueAt) >= 0) {
+      e->dueAt += e->periodMs;
+      if ((long)(now - e->dueAt) >= 0) e->dueAt = now + e->periodMs;
+    } else {
+      e->dueAt = now + e->periodMs;
+    }
+
+    for (w = 0; w < e->count; w++) {
+      value = this->readBuffer[e->address - this->readAddress + w];
+      if (e->known && this->values[e->offset + w] == value) continue;
+      this->values[e->offset + w] = value;
+      changed = true;
+      if (e->handler != NULL) e->handler(e->address + w, value);
+    }
+    e->known = true;
+  }
+  return changed;
+}
+
+// ****************************************************
+// ** Setters
+// ****************************************************
+// Minimum time between the end of a read and the start of the next one, so
+// that many due entries don't take over the link all at once.
+void StoneLCDWatch::setMinGapMs(uint16_t ms) {
+  this->gapMs = ms;
+}
+
+// ****************************************************
+// ** Getters
+// ****************************************************
+// Last value read from a watched variable. False if it hasn't been read yet.
+boolean StoneLCDWatch::getValue(uint16_t address, uint16_t *dst) {
+  StoneLCDWatchEntry *e = this->findEntry(address);
+
+  if (e == NULL || !e->known || dst == NULL) return false;
+  *dst = this->values[e->offset + (address - e->address)];
+  return true;
+}
+
+// Reads completed so far
+uint16_t StoneLCDWatch::getReadCount() {
+  return this->readsDone;
+}
+
+// ****************************************************
+// ** Methods
+// ****************************************************
+// Polls "count" variables starting at address every periodMs. The handler
+// is called with each word that changed; the first reading counts as a
+// change. Ranges can't overlap, and the words are taken from the
+// STONE_WATCH_BUFFER_WORDS shared by all the entries.
+boolean StoneLCDWatch::watch(uint16_t address, uint8_t count, uint32_t periodMs, StoneLCDWatchHandler handler) {
+  StoneLCDWatchEntry *e;
+  uint8_t i;
+
+  if (count == 0 || count > STONE_VAR_READ_MAX_WORDS || (uint32_t)address + count > 0x10000UL) return false;
+  if (this->entryCount >= STONE_WATCH_MAX_ENTRIES || count > STONE_WATCH_BUFFER_WORDS - this->used) return false;
+  for (i = 0; i < this->entryCount; i++) {
+    e = &this->entries[i];
+    if (address < (uint32_t)e->address + e->count && e->address < (uint32_t)address + count) return false;
+  }
+
+  e = &this->entries[this->entryCount++];
+  e->address = address;
+  e->count = count;
+  e->offset = this->used;
+  e->periodMs = periodMs;
+  e->dueAt = millis();
+  e->known = false;
+  e->reading = false;
+  e->handler = handler;
+  this->used += count;
+  return true;
+}
+
+boolean StoneLCDWatch::watch(uint16_t address, uint32_t periodMs, StoneLCDWatchHandler handler) {
+  return this->watch(address, 1, periodMs, handler);
+}
+
+// Makes every entry due now
+void StoneLCDWatch::refresh() {
+  unsigned long now = millis();
+  uint8_t i;
+
+  for (i = 0; i < this->entryCount; i++) this->entries[i].dueAt = now;
+}
+
+// Forgets the last values, so the next reading of each entry is reported in
+// full (e.g. after the display was reset).
+void StoneLCDWatch::invalidate() {
+  uint8_t i;
+
+  for (i = 0; i < this->entryCount; i++) this->entries[i].known = false;
+  this->refresh();
+}
+
+// Call this often (e.g. from loop()). It never waits: it takes the reply of
+// the read in progress, or starts the next one when something is due.
+// Returns true when a read brought changed values.
+boolean StoneLCDWatch::update() {
+  uint8_t status, i;
+  unsigned long now = millis();
+
+  if (this->readHandle >= 0) {
+    status = this->lcd->getReadStatus(this->readHandle);
+    if (status == STONE_READ_PENDING) return false;
+    this->readHandle = -1;
+    this->lastReadAt = now;
+    if (status == STONE_READ_DONE) {
+      this->readsDone++;
+      return this->applyRead(now);
+    }
+    // Failed: the entries stay due and are tried again
+    for (i = 0; i < this->entryCount; i++) this->entries[i].reading = false;
+    return false;
+  }
+
+  if (now - this->lastReadAt < this->gapMs) return false;
+  this->planRead(now);
+  return false;
+}
@@ -0,0 +1,96 @@
+// ************************************************
+// StoneLCDWatch.h                               **
+// ***************************************************************************
+/* Header for StoneLCDWatch; polls variables of a Stone HMI Display that
+ * change without sending events, merging them into as few reads as possible
+ * and reporting only the values that changed. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_LCD_WATCH_H__
+#define _STONE_LCD_WATCH_H__
+
+#include <Arduino.h>
+#include "StoneLCDLib.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// Address ranges a StoneLCDWatch object can track
+#ifndef STONE_WATCH_MAX_ENTRIES
+#define STONE_WATCH_MAX_ENTRIES         8
+#endif
+
+// Words kept (in total) with the last value read for each watched variable
+#ifndef STONE_WATCH_BUFFER_WORDS
+#define STONE_WATCH_BUFFER_WORDS        32
+#endif
+
+// Unwatched words between two ranges that are read anyway to get both in a
+// single read. Each costs 2 bytes of reply; a read of its own costs about 14.
+#define STONE_WATCH_MERGE_GAP           4
+
+#define STONE_WATCH_DEFAULT_GAP         10  // ms between the end of a read and the next one
+
+/*############################################################################
+ *##                                                                        ##
+ *##                              S T R U C T S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+typedef void (*StoneLCDWatchHandler)(uint16_t address, uint16_t value);
+
+typedef struct {
+  uint16_t address;
+  uint8_t  count;          // Words
+  uint8_t  offset;         // Of its last values in the value buffer
+  uint32_t periodMs;
+  unsigned long dueAt;
+  boolean  known;          // Has been read at least once
+  boolean  reading;        // Part of the read in progress
+  StoneLCDWatchHandler handler;
+} StoneLCDWatchEntry;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                         S t o n e L C D W a t c h                      ##
+ *##                                                                        ##
+ *############################################################################*/
+class StoneLCDWatch {
+private:
+  StoneLCD *lcd;
+  uint8_t  entryCount;
+  uint8_t  used;           // Words of the value buffer taken
+  uint16_t gapMs;
+  int8_t   readHandle;
+  uint16_t readAddress;
+  uint8_t  readCount;
+  unsigned long lastReadAt;     // When the last read finished
+  uint16_t readsDone;
+  StoneLCDWatchEntry entries[STONE_WATCH_MAX_ENTRIES];
+  uint16_t values[STONE_WATCH_BUFFER_WORDS];
+  uint16_t readBuffer[STONE_VAR_READ_MAX_WORDS];
+
+  StoneLCDWatchEntry *findEntry(uint16_t address);
+  StoneLCDWatchEntry *mostOverdue(unsigned long now);
+  boolean  planRead(unsigned long now);
+  boolean  applyRead(unsigned long now);
+
+public:
+  StoneLCDWatch(StoneLCD *display);
+
+  boolean watch(uint16_t address, uint8_t count, uint32_t periodMs, StoneLCDWatchHandler handler);
+  boolean watch(uint16_t address, uint32_t periodMs, StoneLCDWatchHandler handler);
+  void    setMinGapMs(uint16_t ms);
+
+  boolean getValue(uint16_t address, uint16_t *dst);
+  uint16_t getReadCount();
+
+  void    refresh();
+  void    invalidate();
+  boolean update();
+};
+#endif
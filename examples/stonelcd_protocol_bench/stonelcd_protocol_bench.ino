@@ -0,0 +1,214 @@
+#include <StoneLCDLib.h>
+#include <StoneLCDSim.h>
+
+ /************************************************/
+ /* stonelcd_protocol_bench.ino                  */
+ /*****************************************************************************/
+ /* Runs the public StoneLCD API against a simulated display (StoneLCDSim)
+  *  and reports, for each operation, the frames and bytes that went over the
+  *  wire and the time it took with the modeled baud rate.
+  *
+  *  No display is needed: results are printed on the Serial Monitor. Change
+  *  SIM_BAUD_RATE to model other link speeds. It can also be built and run
+  *  on a PC, with "make run" in extras/host.
+  *
+  *  Note: StoneLCDSim keeps the whole register and variable memory of the
+  *  display in RAM, so boards with more than 2KB of RAM are recommended.
+  */
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+#define SIM_BAUD_RATE         9600
+
+// Same addresses the RGB strip example uses
+#define BTTN_ONOFF            0x0001
+#define ICON_WHITE            0x0002
+#define ICON_RED              0x0003
+#define ICON_GREEN            0x0004
+#define ICON_BLUE             0x0005
+#define TEXT_WHITE            0x0006
+#define TEXT_RED              0x0007
+#define TEXT_GREEN            0x0008
+#define TEXT_BLUE             0x0009
+
+/*############################################################################
+ *##                                                                        ##
+ *##                                G L O B A L                             ##
+ *##                                                                        ##
+ *############################################################################*/
+StoneLCDSim       sim (SIM_BAUD_RATE);
+StoneLCD          myLCD (&sim);
+
+unsigned long     benchStart;
+
+/*############################################################################
+ *##                                                                        ##
+ *##                           R E P O R T I N G                            ##
+ *##                                                                        ##
+ *############################################################################*/
+void startBench(){
+  sim.flush();
+  sim.resetStats();
+  benchStart = micros();
+}
+
+// Waits for the last byte sent to leave the line, and prints the results
+void endBench(const char *name){
+  StoneLCDSimStats stats;
+  unsigned long elapsed;
+
+  sim.flush();
+  elapsed = micros() - benchStart;
+  sim.getStats(&stats);
+
+  Serial.print(name);
+  Serial.print(": frames ");
+  Serial.print(stats.hostFrames);
+  Serial.print("/");
+  Serial.print(stats.displayFrames);
+  Serial.print(", bytes ");
+  Serial.print(stats.hostBytes);
+  Serial.print("/");
+  Serial.print(stats.displayBytes);
+  Serial.print(", wire ");
+  Serial.print(stats.wireTimeUs);
+  Serial.print(" us, latency ");
+  Serial.print(elapsed);
+  Serial.println(" us");
+}
+
+/*############################################################################
+ *##                                                                        ##
+ *##                            B E N C H M A R K S                         ##
+ *##                                                                        ##
+ *############################################################################*/
+void benchBasicCalls(){
+  uint16_t words[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  uint8_t regs[16];
+  StoneLCDDateTime dateTime(2020, 12, 31, 0, 23, 59, 58);
+
+  startBench();
+  myLCD.writeVariableWord(TEXT_RED, 0x24);
+  endBench("writeVariableWord");
+
+  startBench();
+  myLCD.writeVariable(0x0010, words, 8);
+  endBench("writeVariable x8");
+
+  startBench();
+  myLCD.readVariableWord(TEXT_RED);
+  endBench("readVariableWord");
+
+  startBench();
+  myLCD.readRegister(STONE_REG_VERSION, regs, 16);
+  endBench("readRegister x16");
+
+  startBench();
+  myLCD.setCurrentPage(1);
+  endBench("setCurrentPage");
+
+  startBench();
+  myLCD.playSound(1, 0x40);
+  endBench("playSound");
+
+  startBench();
+  myLCD.setRTC(&dateTime);
+  endBench("setRTC");
+
+  startBench();
+  myLCD.getRTC(&dateTime);
+  endBench("getRTC");
+}
+
+// The RGB strip example's UI refresh, as it was written and batched
+void benchUIRefresh(){
+  startBench();
+  myLCD.writeVariableWord(BTTN_ONOFF, 1);
+  myLCD.writeVariableWord(TEXT_WHITE, 0);
+  myLCD.writeVariableWord(TEXT_RED,   0x24);
+  myLCD.writeVariableWord(TEXT_GREEN, 0x10);
+  myLCD.writeVariableWord(TEXT_BLUE,  0x32);
+  myLCD.writeVariableWord(ICON_WHITE, 0);
+  myLCD.writeVariableWord(ICON_RED,   1);
+  myLCD.writeVariableWord(ICON_GREEN, 1);
+  myLCD.writeVariableWord(ICON_BLUE,  1);
+  endBench("UI refresh, single writes");
+
+  startBench();
+  myLCD.beginBatch();
+  myLCD.writeVariableWord(BTTN_ONOFF, 1);
+  myLCD.writeVariableWord(TEXT_WHITE, 0);
+  myLCD.writeVariableWord(TEXT_RED,   0x24);
+  myLCD.writeVariableWord(TEXT_GREEN, 0x10);
+  myLCD.writeVariableWord(TEXT_BLUE,  0x32);
+  myLCD.writeVariableWord(ICON_WHITE, 0);
+  myLCD.writeVariableWord(ICON_RED,   1);
+  myLCD.writeVariableWord(ICON_GREEN, 1);
+  myLCD.writeVariableWord(ICON_BLUE,  1);
+  myLCD.flushBatch();
+  endBench("UI refresh, batched");
+}
+
+// The RGB strip example's UI read, as it was written and pipelined
+void benchUIRead(){
+  uint16_t values[4];
+  int8_t handles[4];
+  uint8_t i;
+
+  startBench();
+  for (i = 0; i < 4; i++) values[i] = myLCD.readVariableWord(TEXT_WHITE + i);
+  endBench("UI read, blocking");
+
+  startBench();
+  for (i = 0; i < 4; i++) handles[i] = myLCD.requestVariableRead(TEXT_WHITE + i, &values[i], 1);
+  for (i = 0; i < 4; i++) {
+    while (myLCD.getReadStatus(handles[i]) == STONE_READ_PENDING);
+  }
+  endBench("UI read, pipelined");
+
+  startBench();
+  myLCD.readVariable(TEXT_WHITE, values, 4);
+  endBench("UI read, one frame");
+}
+
+void benchEvent(){
+  StoneLCDEvent evt;
+  uint16_t data[2];
+
+  startBench();
+  sim.touchVariable(TEXT_RED, 0x30);
+  while (!myLCD.checkForIOEvent(&evt, data, 2));
+  endBench("Touch event");
+}
+
+/*############################################################################
+ *##                                                                        ##
+ *##                                 S E T U P                              ##
+ *##                                                                        ##
+ *############################################################################*/
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  Serial.print("Simulated link at ");
+  Serial.print((unsigned long)SIM_BAUD_RATE);
+  Serial.println(" baud (frames and bytes are host/display)");
+
+  benchBasicCalls();
+  benchUIRefresh();
+  benchUIRead();
+  benchEvent();
+}
+
+/*############################################################################
+ *##                                                                        ##
+ *##                                  L O O P                               ##
+ *##                                                                        ##
+ *############################################################################*/
+void loop() {
+}
@@ -1,4 +1,6 @@
 #include <StoneLCDLib.h>
+#include <StoneLCDWatch.h>
+#include <StoneLCDAnim.h>
 #include <Adafruit_NeoPixel.h>
 
  /************************************************/
@@ -57,7 +59,6 @@
 #define ICON_ON               1
 
 /* Other constants ******************************/
-#define MAX_RECV_BUFFER       4
 #define MAX_LED_COUNT         27
 
 /*############################################################################
@@ -74,19 +75,35 @@ struct {
 
 StoneLCD          myLCD (&Serial);  // Can use a soft-serial port if care is taken
                                     //  to constantly scan for incoming messages.
+StoneLCDWatch     uiWatch (&myLCD); // Polls the UI values in the background
+StoneLCDAnim      blinker (&myLCD); // Paces the blinking sequences
 Adafruit_NeoPixel strip(MAX_LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800);
 
-StoneLCDEvent evt;
-uint16_t      recvBuffer[MAX_RECV_BUFFER];
 uint8_t       led_count = MAX_LED_COUNT;
 
-// The following variables are used by the blinking functions, which were copied
-// directly from the example provided by STONE. 
+// The blinking sequences follow the ones of the example provided by STONE,
+// but are timed by "blinker" (from millis()) instead of delay(1) and loop
+// counters, so they keep their speed whatever the serial traffic.
 uint8_t       blink_type = 0;
-uint8_t       times = 0;
-uint8_t       BLINK_2 = 0;
-uint8_t       USER_R = 0, USER_G = 0, USER_B = 0, COLOR_TYPE = 0, COLOR_DIR = 0;
-uint16_t      k, q;
+uint8_t       blink_color = 0;    // Index in BLINK_COLORS
+uint8_t       blink_level = 0;    // Brightness, 0 - 250
+
+// Full-brightness colors, scaled by blink_level
+const byte BLINK_COLORS[9][3] = {
+  {250, 0, 0}, {0, 250, 0}, {0, 0, 250}, {250, 250, 0}, {0, 250, 250}, {250, 0, 250},
+  {125, 250, 0}, {0, 150, 250}, {250, 0, 100}
+};
+
+// Sequence 1: each of the first 6 colors fades in and out (14 ms per step)
+const StoneLCDKeyframe BLINK1_COLORS[] = {{0, 0}, {6944, 1}, {13888, 2}, {20832, 3}, {27776, 4}, {34720, 5}, {41664, 0}};
+const StoneLCDKeyframe BLINK1_LEVELS[] = {{0, 2}, {3472, 250}, {6944, 2}};
+// Sequence 2: all 9 colors, 150 ms each
+const StoneLCDKeyframe BLINK2_COLORS[] = {{0, 0}, {150, 1}, {300, 2}, {450, 3}, {600, 4}, {750, 5}, {900, 6}, {1050, 7}, {1200, 8}, {1350, 0}};
+// Sequence 3: the first 6 colors, 1 s each
+const StoneLCDKeyframe BLINK3_COLORS[] = {{0, 0}, {1000, 1}, {2000, 2}, {3000, 3}, {4000, 4}, {5000, 5}, {6000, 0}};
+// Sequence 4: the first 6 colors, 500 ms each, ramping up twice
+const StoneLCDKeyframe BLINK4_COLORS[] = {{0, 0}, {500, 1}, {1000, 2}, {1500, 3}, {2000, 4}, {2500, 5}, {3000, 0}};
+const StoneLCDKeyframe BLINK4_LEVELS[] = {{0, 0}, {250, 250}};
 
 /*############################################################################
  *##                                                                        ##
@@ -100,29 +117,28 @@ void updateWRGBIcons(){
   myLCD.writeVariableWord(ICON_BLUE,    (rgbStatus.blue > 0));
 }
 
+void checkForSwitchAutoOff(){
+  if ((rgbStatus.red == 0) && (rgbStatus.green == 0) && (rgbStatus.blue == 0) && (rgbStatus.white == 0) && (blink_type == 0)){
+    myLCD.writeVariableWord(BTTN_ONOFF, ICON_OFF);
+  }else{
+    myLCD.writeVariableWord(BTTN_ONOFF, ICON_ON);
+  }
+}
+
 void updateUIFromrgbStatus(){
+  // Queue all the writes and send them together. Adjacent addresses end up in
+  // the same frame.
+  myLCD.beginBatch();
   myLCD.writeVariableWord(TEXT_WHITE,   rgbStatus.white);
   myLCD.writeVariableWord(TEXT_RED,     rgbStatus.red);
   myLCD.writeVariableWord(TEXT_GREEN,   rgbStatus.green);
   myLCD.writeVariableWord(TEXT_BLUE,    rgbStatus.blue);
 
   updateWRGBIcons();
+  checkForSwitchAutoOff();
+  myLCD.flushBatch();
 }
 
-void updatergbStatusFromUI() {
-  rgbStatus.white     = myLCD.readVariableWord(TEXT_WHITE);
-  rgbStatus.red       = myLCD.readVariableWord(TEXT_RED);
-  rgbStatus.green     = myLCD.readVariableWord(TEXT_GREEN);
-  rgbStatus.blue      = myLCD.readVariableWord(TEXT_BLUE);
-}
-
-void checkForSwitchAutoOff(){
-  if ((rgbStatus.red == 0) && (rgbStatus.green == 0) && (rgbStatus.blue == 0) && (rgbStatus.white == 0) && (blink_type == 0)){
-    myLCD.writeVariableWord(BTTN_ONOFF, ICON_OFF);
-  }else{
-    myLCD.writeVariableWord(BTTN_ONOFF, ICON_ON);
-  }
-}
 /*############################################################################
  *##                                                                        ##
  *##                          R G B   S T R I P                             ##
@@ -162,134 +178,44 @@ void updateRGBStrip(){
   rgbStatus.blue  = 0;
 }
 
-void blink1(){
-  times++;
-  if (times >= 14) {
-    times = 0;
-    if (COLOR_DIR == 0) {
-      if (COLOR_TYPE == 0) {
-        USER_R++;
-        USER_G = 0;
-        USER_B = 0;
-      } else if (COLOR_TYPE == 1) {
-        USER_R = 0;
-        USER_G++;
-        USER_B = 0;
-      } else if (COLOR_TYPE == 2) {
-        USER_R = 0;
-        USER_G = 0;
-        USER_B++;
-      } else if (COLOR_TYPE == 3) {
-        USER_R++;
-        USER_G++;
-        USER_B = 0;
-      } else if (COLOR_TYPE == 4) {
-        USER_R = 0;
-        USER_G++;
-        USER_B++;
-      } else if (COLOR_TYPE == 5) {
-        USER_R++;
-        USER_G = 0;
-        USER_B++;
-      }
-      if ((USER_R >= 250) || (USER_G >= 250) || (USER_B >= 250)) {
-        COLOR_DIR = 1;
-      }
-    } else {
-      if (COLOR_TYPE == 0) {
-        USER_R--;
-        USER_G = 0;
-        USER_B = 0;
-      } else if (COLOR_TYPE == 1) {
-        USER_R = 0;
-        USER_G--;
-        USER_B = 0;
-      } else if (COLOR_TYPE == 2) {
-        USER_R = 0;
-        USER_G = 0;
-        USER_B--;
-      } else if (COLOR_TYPE == 3) {
-        USER_R--;
-        USER_G--;
-        USER_B = 0;
-      } else if (COLOR_TYPE == 4) {
-        USER_R = 0;
-        USER_G--;
-        USER_B--;
-      } else if (COLOR_TYPE == 5) {
-        USER_R--;
-        USER_G = 0;
-        USER_B--;
-      }
-      if ((USER_R == 0x02) || (USER_G == 0x02) || (USER_B == 0x02)) {
-        COLOR_DIR = 0;
-        COLOR_TYPE++;
-        if (COLOR_TYPE > 5) COLOR_TYPE = 0;
-      }
-    }
-    setFullRGBStrip (USER_R, USER_G, USER_B);
-  }
-  delay(1);
+void showBlinkColor(){
+  const byte *c = BLINK_COLORS[blink_color];
+  setFullRGBStrip(((uint16_t)c[0] * blink_level) / 250, ((uint16_t)c[1] * blink_level) / 250, ((uint16_t)c[2] * blink_level) / 250);
 }
 
-void blink2(){
-  k++;
-  if (k >= 150){
-    k = 0;
-    q = 200;
-
-    BLINK_2++;
-    if (BLINK_2 > 8) BLINK_2 = 0;
-    
-    if (BLINK_2 == 0)       setFullRGBStrip(q, 0, 0);
-    else if (BLINK_2 == 1)  setFullRGBStrip(0, q, 0);
-    else if (BLINK_2 == 2)  setFullRGBStrip(0, 0, q);
-    else if (BLINK_2 == 3)  setFullRGBStrip(q, q, 0);
-    else if (BLINK_2 == 4)  setFullRGBStrip(0, q, q);
-    else if (BLINK_2 == 5)  setFullRGBStrip(q, 0, q);
-    else if (BLINK_2 == 6)  setFullRGBStrip(q - 100, q, 0);
-    else if (BLINK_2 == 7)  setFullRGBStrip(0, q - 80, q);
-    else if (BLINK_2 == 8)  setFullRGBStrip(q, 0, q - 120);
-  }
-  delay(1);
+// Called by blinker with the new values of the sequence
+void onBlinkColor(int8_t track, uint16_t value){
+  blink_color = value;
+  showBlinkColor();
 }
 
-void blink3(){
-  k++;
-  if (k >= 1000) {
-    k = 0;
-
-    BLINK_2++;
-    if (BLINK_2 > 5) BLINK_2 = 0;
+void onBlinkLevel(int8_t track, uint16_t value){
+  blink_level = value;
+  showBlinkColor();
+}
 
-    if (BLINK_2 == 0)      setFullRGBStrip(q, 0, 0);
-    else if (BLINK_2 == 1) setFullRGBStrip(0, q, 0);
-    else if (BLINK_2 == 2) setFullRGBStrip(0, 0, q);
-    else if (BLINK_2 == 3) setFullRGBStrip(q, q, 0);
-    else if (BLINK_2 == 4) setFullRGBStrip(0, q, q);
-    else if (BLINK_2 == 5) setFullRGBStrip(q, 0, q);
+void startBlink(uint8_t type){
+  blinker.stopAll();
+  blink_type  = type;
+  blink_color = 0;
+  blink_level = 200;
+
+  if (type == 1) {
+    blinker.play(STONE_ANIM_NO_ADDRESS, BLINK1_COLORS, 7, STONE_ANIM_STEP | STONE_ANIM_LOOP, onBlinkColor);
+    blinker.play(STONE_ANIM_NO_ADDRESS, BLINK1_LEVELS, 3, STONE_ANIM_LINEAR | STONE_ANIM_LOOP, onBlinkLevel);
+  } else if (type == 2) {
+    blinker.play(STONE_ANIM_NO_ADDRESS, BLINK2_COLORS, 10, STONE_ANIM_STEP | STONE_ANIM_LOOP, onBlinkColor);
+  } else if (type == 3) {
+    blinker.play(STONE_ANIM_NO_ADDRESS, BLINK3_COLORS, 7, STONE_ANIM_STEP | STONE_ANIM_LOOP, onBlinkColor);
+  } else if (type == 4) {
+    blinker.play(STONE_ANIM_NO_ADDRESS, BLINK4_COLORS, 7, STONE_ANIM_STEP | STONE_ANIM_LOOP, onBlinkColor);
+    blinker.play(STONE_ANIM_NO_ADDRESS, BLINK4_LEVELS, 2, STONE_ANIM_LINEAR | STONE_ANIM_LOOP, onBlinkLevel);
   }
-  delay(1);
 }
 
-void blink4(){
-  k++;
-  if (k >= 500) {
-    k = 0;
-    q = 0;
-    BLINK_2++;
-    if (BLINK_2 > 5) BLINK_2 = 0;
-  }
-  q++;
-  if (q >= 250) q = 0;
-
-  if (BLINK_2 == 0)      setFullRGBStrip(q, 0, 0);
-  else if (BLINK_2 == 1) setFullRGBStrip(0, q, 0);
-  else if (BLINK_2 == 2) setFullRGBStrip(0, 0, q);
-  else if (BLINK_2 == 3) setFullRGBStrip(q, q, 0);
-  else if (BLINK_2 == 4) setFullRGBStrip(0, q, q);
-  else if (BLINK_2 == 5) setFullRGBStrip(q, 0, q);
-  delay(1);
+void stopBlink(){
+  blinker.stopAll();
+  blink_type = 0;
 }
 
 /*############################################################################
@@ -302,6 +228,84 @@ void setDateTime(){
   myLCD.setRTC(&dateTime);
 }
 
+/*############################################################################
+ *##                                                                        ##
+ *##                    E V E N T   H A N D L E R S                         ##
+ *##                                                                        ##
+ *############################################################################*/
+// All values the UI handles for this example are bytes, so the handlers use
+// the first byte in the message content as the value.
+void onNumOfLeds(StoneLCDEvent *e, uint16_t *data) {
+  led_count = data[0];
+  updateRGBStrip();
+}
+
+void onOnOffButton(StoneLCDEvent *e, uint16_t *data) {
+  stopBlink();
+  if (data[0] == 0){
+    allRGBOff();
+  } else {
+    rgbStatus.white = 0;
+    rgbStatus.red   = 0x24;
+    rgbStatus.green = 0x10;
+    rgbStatus.blue  = 0x32;
+  }
+  updateRGBStrip();
+}
+
+void onColorText(StoneLCDEvent *e, uint16_t *data) {
+  byte value = data[0];
+
+  stopBlink();
+  switch (e->address){
+    case TEXT_WHITE:
+      allRGBOff();
+      rgbStatus.white = value;
+      break;
+
+    case TEXT_RED:
+      rgbStatus.red   = value;
+      rgbStatus.white = 0;
+      break;
+
+    case TEXT_GREEN:
+      rgbStatus.green = value;
+      rgbStatus.white = 0;
+      break;
+
+    case TEXT_BLUE:
+      rgbStatus.blue  = value;
+      rgbStatus.white = 0;
+      break;
+  }
+  updateRGBStrip();
+}
+
+void onBlinkButton(StoneLCDEvent *e, uint16_t *data) {
+  allRGBOff();
+  startBlink(e->address - BTTN_BLINK1 + 1);
+}
+
+// Called by uiWatch
+void onUIValueChanged(uint16_t address, uint16_t value) {
+  switch (address){
+    case TEXT_WHITE:  rgbStatus.white = value; break;
+    case TEXT_RED:    rgbStatus.red   = value; break;
+    case TEXT_GREEN:  rgbStatus.green = value; break;
+    case TEXT_BLUE:   rgbStatus.blue  = value; break;
+    case NUM_OF_LEDS: led_count       = value; break;
+  }
+  if (blink_type == 0) updateRGBStrip();
+}
+
+// The four color values are contiguous, so they are polled with a single
+// read. The handler only gets the ones that changed (all of them the first
+// time).
+void watchUIValues() {
+  uiWatch.watch(TEXT_WHITE, 4, 2000, onUIValueChanged);
+  uiWatch.watch(NUM_OF_LEDS, 2000, onUIValueChanged);
+}
+
 /*############################################################################
  *##                                                                        ##
  *##                                 S E T U P                              ##
@@ -323,11 +327,14 @@ void setup() {
   // LCD to be overwritten
   setDateTime();
 
-  // Read UI values into our app data
-  updatergbStatusFromUI();
+  // UI values (colors and LED count) are read into our app data by uiWatch
+  watchUIValues();
 
-  // Also read initial LED count
-  led_count = myLCD.readVariableWord(NUM_OF_LEDS);
+  // Events are dispatched to these handlers by poll()
+  myLCD.onEvent(NUM_OF_LEDS, onNumOfLeds);
+  myLCD.onEvent(BTTN_ONOFF, onOnOffButton);
+  myLCD.onEventRange(TEXT_WHITE, TEXT_BLUE, onColorText);
+  myLCD.onEventRange(BTTN_BLINK1, BTTN_BLINK4, onBlinkButton);
 
   // Let's start the loop() cycle discarding pending bytes from the screen,
   // if any.
@@ -340,94 +347,14 @@ void setup() {
  *##                                                                        ##
  *############################################################################*/
 void loop() {
-  byte i;
-  byte value;
-  boolean recvEvent;
-
-  recvEvent = myLCD.checkForIOEvent(&evt, recvBuffer, MAX_RECV_BUFFER);
-  if (recvEvent){
-    // Let's clear any remaining of pending messages
-    myLCD.clearInputStream();
-
-    // All values the UI handles for this example are bytes, so let's get the
-    // first byte in the message content, and use it as the value from now on
-    value = recvBuffer[0];
-
-    switch (evt.address){
-      case NUM_OF_LEDS:
-        led_count = value;
-        updateRGBStrip();
-        break;
-
-      case BTTN_ONOFF:
-        blink_type = 0;
-        if (value == 0){
-          allRGBOff();
-        } else {
-          rgbStatus.white = 0;
-          rgbStatus.red   = 0x24;
-          rgbStatus.green = 0x10;
-          rgbStatus.blue  = 0x32;
-        }
-        updateRGBStrip();
-        break;
-
-      case TEXT_WHITE:
-        allRGBOff();
-        blink_type      = 0;
-        rgbStatus.white = value;
-        updateRGBStrip();
-        break;
-
-      case TEXT_RED:
-        blink_type      = 0;
-        rgbStatus.red   = value;
-        rgbStatus.white = 0;
-        updateRGBStrip();
-        break;
-
-      case TEXT_GREEN:
-        blink_type      = 0;
-        rgbStatus.green = value;
-        rgbStatus.white = 0;
-        updateRGBStrip();
-        break;
-
-      case TEXT_BLUE:
-        blink_type      = 0;
-        rgbStatus.blue  = value;
-        rgbStatus.white = 0;
-        updateRGBStrip();
-        break;
-
-      case BTTN_BLINK1:
-        blink_type = 1;
-        allRGBOff();
-        break;
-
-      case BTTN_BLINK2:
-        blink_type = 2;
-        allRGBOff();
-        break;
-
-      case BTTN_BLINK3:
-        blink_type = 3;
-        allRGBOff();
-        break;
-
-      case BTTN_BLINK4:
-        blink_type = 4;
-        allRGBOff();
-        break;
-    }
-    checkForSwitchAutoOff();
+  uiWatch.update();
+
+  // Handle every event received since the last call
+  if (myLCD.poll() > 0){
     updateUIFromrgbStatus();
-  } else {
-    // No event received from the UI,
-    // process / animate current blinking seq.
-    if (blink_type == 1)      blink1();
-    else if (blink_type == 2) blink2();
-    else if (blink_type == 3) blink3();
-    else if (blink_type == 4) blink4();
   }
+
+  // Animate the current blinking sequence, if any. This never waits, so
+  // events keep being handled while it runs.
+  blinker.update();
 }
@@ -0,0 +1,101 @@
+// ************************************************
+// Arduino.h (host)                              **
+// ***************************************************************************
+/* Minimal stand-in for the Arduino core, enough to build StoneLCDLib and
+ * StoneLCDSim with a regular compiler (g++) and run sketches that only use
+ * them and Serial on a PC. Time comes from the host's monotonic clock.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#ifndef _STONE_HOST_ARDUINO_H__
+#define _STONE_HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+typedef bool    boolean;
+typedef uint8_t byte;
+
+// There's no separate flash on the host
+#define PROGMEM
+#define pgm_read_byte(p)                (*(const uint8_t *)(p))
+#define pgm_read_word(p)                (*(const uint16_t *)(p))
+#define memcpy_P                        memcpy
+
+/*############################################################################
+ *##                                                                        ##
+ *##                          F U N C T I O N S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+/*############################################################################
+ *##                                                                        ##
+ *##                      P r i n t   /   S t r e a m                       ##
+ *##                                                                        ##
+ *############################################################################*/
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  virtual int    availableForWrite() { return 0; }
+
+  size_t write(const char *str) { return this->write((const uint8_t *)str, strlen(str)); }
+
+  size_t print(const char *str);
+  size_t print(char c);
+  size_t print(unsigned long n);
+  size_t print(long n);
+  size_t print(unsigned int n)  { return this->print((unsigned long)n); }
+  size_t print(int n)           { return this->print((long)n); }
+  size_t println();
+  size_t println(const char *str)      { return this->print(str) + this->println(); }
+  size_t println(unsigned long n)      { return this->print(n) + this->println(); }
+  size_t println(long n)               { return this->print(n) + this->println(); }
+  size_t println(unsigned int n)       { return this->print(n) + this->println(); }
+  size_t println(int n)                { return this->print(n) + this->println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int  available() = 0;
+  virtual int  read() = 0;
+  virtual int  peek() = 0;
+  virtual void flush() {}
+};
+
+// Serial goes to stdout, and never has anything to read
+class HostSerial : public Stream {
+public:
+  void   begin(unsigned long baud) {}
+  operator bool() { return true; }
+
+  int    available() { return 0; }
+  int    read() { return -1; }
+  int    peek() { return -1; }
+  void   flush() { fflush(stdout); }
+  size_t write(uint8_t b) { return fputc(b, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+  int    availableForWrite() { return 64; }
+  using Print::write;
+};
+
+extern HostSerial Serial;
+
+template<class T> T min(T a, T b) { return a < b ? a : b; }
+template<class T> T max(T a, T b) { return a > b ? a : b; }
+#endif
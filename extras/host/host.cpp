@@ -0,0 +1,110 @@
+// ************************************************
+// host.cpp                                      **
+// ***************************************************************************
+/* Host side of the Arduino stand-in: clock, Serial, and a main() that runs
+ * the sketch's setup() and then loop() for a while. Part of StoneLCDLib.
+ *
+ * Author: Elias Zacarias
+ * URL: https://github.com/battlecoder/StoneLCDLib
+*/
+
+#include <time.h>
+#include "Arduino.h"
+
+/*############################################################################
+ *##                                                                        ##
+ *##                               D E F I N E S                            ##
+ *##                                                                        ##
+ *############################################################################*/
+// How many times loop() is called before exiting
+#ifndef HOST_LOOP_COUNT
+#define HOST_LOOP_COUNT                 1
+#endif
+
+/*############################################################################
+ *##                                                                        ##
+ *##                                G L O B A L                             ##
+ *##                                                                        ##
+ *############################################################################*/
+HostSerial Serial;
+
+static struct timespec startTime;
+
+void setup();
+void loop();
+
+/*############################################################################
+ *##                                                                        ##
+ *##                          F U N C T I O N S                             ##
+ *##                                                                        ##
+ *############################################################################*/
+// Like on a board, the clock starts at 0 when the program does
+unsigned long micros() {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)((now.tv_sec - startTime.tv_sec) * 1000000L + (now.tv_nsec - startTime.tv_nsec) / 1000);
+}
+
+unsigned long millis() {
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+  struct timespec t;
+
+  t.tv_sec = ms / 1000;
+  t.tv_nsec = (ms % 1000) * 1000000L;
+  nanosleep(&t, NULL);
+}
+
+void yield() {
+}
+
+// ****************************************************
+// ** Print
+// ****************************************************
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size-- > 0) n += this->write(*buffer++);
+  return n;
+}
+
+size_t Print::print(const char *str) {
+  return this->write(str);
+}
+
+size_t Print::print(char c) {
+  return this->write((uint8_t)c);
+}
+
+size_t Print::print(unsigned long n) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", n);
+  return this->write(buf);
+}
+
+size_t Print::print(long n) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", n);
+  return this->write(buf);
+}
+
+size_t Print::println() {
+  return this->write("\r\n");
+}
+
+/*############################################################################
+ *##                                                                        ##
+ *##                                  M A I N                               ##
+ *##                                                                        ##
+ *############################################################################*/
+int main() {
+  unsigned long i;
+
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
+  setup();
+  for (i = 0; i < HOST_LOOP_COUNT; i++) loop();
+  Serial.flush();
+  return 0;
+}